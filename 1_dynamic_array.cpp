@@ -1,52 +1,139 @@
 #include <bits/stdc++.h>
+#include "dynamic_array.h"
+#include "bench_util.h"
 using namespace std;
 
-int *arr;
-int sz = 0, cap = 1;
-
-void show() {
-    cout << "sz=" << sz << " cap=" << cap << " [";
-    for (int i = 0; i < sz; i++) {
+template <class T>
+void show(const DynamicArray<T>& arr) {
+    cout << "sz=" << arr.size() << " cap=" << arr.capacity() << " [";
+    for (size_t i = 0; i < arr.size(); i++) {
         cout << arr[i];
-        if (i < sz - 1) cout << ",";
+        if (i + 1 < arr.size()) cout << ",";
     }
     cout << "]\n";
 }
 
-void resize(int newCap) {
-    int *newArr = new int[newCap];
-    for (int i = 0; i < sz; i++) {
-        newArr[i] = arr[i];
-    }
-    delete[] arr;
-    arr = newArr;
-    cap = newCap;
+// Push n ints, then pop them all. Peak counts the old and new block that
+// coexist during each move, relative to the n * 4 bytes of live data.
+template <class Policy>
+void benchPolicy(const char* name, size_t n) {
+    size_t baseBytes = bench::AllocStats::liveBytes, baseCalls = bench::AllocStats::calls;
+    bench::AllocStats::resetPeak();
+    DynamicArray<int, bench::CountingAllocator<int>, Policy> arr;
+    
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++) arr.push_back(i);
+    double pushNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    size_t peak = bench::AllocStats::peakBytes - baseBytes;
+    size_t growAllocs = bench::AllocStats::calls - baseCalls;
+    double slack = (double)arr.capacity() / n;
+    
+    start = chrono::steady_clock::now();
+    while (arr.pop_back()) {}
+    double popNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    
+    cout << left << setw(22) << name << right << fixed << setprecision(2)
+         << setw(9) << pushNs << setw(9) << popNs
+         << setw(12) << (double)peak / (n * sizeof(int))
+         << setw(10) << slack
+         << setw(10) << growAllocs << setw(10) << bench::AllocStats::calls - baseCalls - growAllocs << "\n";
+}
+
+// Same loop on the default allocator, where int storage grows in place with
+// realloc/mremap; memory columns are not tracked on this path
+void benchInPlace(size_t n) {
+    DynamicArray<int> arr;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++) arr.push_back(i);
+    double pushNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    
+    start = chrono::steady_clock::now();
+    while (arr.pop_back()) {}
+    double popNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    
+    cout << left << setw(22) << "2x, realloc/mremap" << right << fixed << setprecision(2)
+         << setw(9) << pushNs << setw(9) << popNs << "\n";
+    
+    // One push_bulk and one pop_bulk for the whole batch
+    vector<int> batch(n);
+    iota(batch.begin(), batch.end(), 0);
+    start = chrono::steady_clock::now();
+    arr.push_bulk(batch.data(), n);
+    pushNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    
+    start = chrono::steady_clock::now();
+    arr.pop_bulk(n);
+    popNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+    
+    cout << left << setw(22) << "push_bulk/pop_bulk" << right
+         << setw(9) << pushNs << setw(9) << popNs << "\n";
 }
 
-void push(int x) {
-    if (sz == cap) resize(cap * 2);
-    arr[sz++] = x;
-    show();
+void runBenchmark(size_t n) {
+    cout << "Growth policies, " << n << " pushes then " << n << " pops\n";
+    cout << left << setw(22) << "Policy" << right << setw(9) << "push ns" << setw(9) << "pop ns"
+         << setw(12) << "peak/live" << setw(10) << "cap/live" << setw(10) << "grows" << setw(10) << "shrinks" << "\n";
+    benchPolicy<DoublingGrowth>("2x, shrink at 1/4", n);
+    benchPolicy<OneAndHalfGrowth>("1.5x, shrink at 1/3", n);
+    benchPolicy<GrowthPolicy<5, 4, 2, 16>>("1.25x, shrink at 1/2", n);
+    benchInPlace(n);
+    
+    size_t baseBytes = bench::AllocStats::liveBytes;
+    DynamicArray<int, bench::CountingAllocator<int>> arr;
+    for (size_t i = 0; i < n; i++) arr.push_back(i);
+    size_t before = bench::AllocStats::liveBytes - baseBytes;
+    arr.shrink_to_fit();
+    cout << "shrink_to_fit after 2x growth: " << before << " -> "
+         << bench::AllocStats::liveBytes - baseBytes << " bytes\n";
 }
 
-void pop() {
-    if (sz == 0) {
-        cout << "Array is empty!\n";
-        return;
+// push/pop/push_bulk/pop_bulk at every size up to maxSize; bytes/key is
+// capacity over size after the pushes
+void runSuite(size_t maxSize) {
+    cout << "\nDynamicArray<int> operations\n";
+    bench::printHeader();
+    for (size_t n : bench::benchSizes(maxSize)) {
+        vector<uint32_t> keys = bench::makeKeys(n, bench::UNIFORM);
+        DynamicArray<int> arr;
+        
+        bench::Result push = bench::timeOps(n, [&](size_t i) { arr.push_back(keys[i]); });
+        double bytesPerKey = (double)arr.capacity() * sizeof(int) / n;
+        bench::printRow("push_back", bench::UNIFORM, n, -1, push, bytesPerKey);
+        
+        bench::Result pop = bench::timeOps(n, [&](size_t) { arr.pop_back(); });
+        bench::printRow("pop_back", bench::UNIFORM, n, -1, pop, -1);
+        
+        // One call per 1024-element chunk
+        const size_t CHUNK = 1024;
+        size_t chunks = (n + CHUNK - 1) / CHUNK;
+        bench::Result pushBulk = bench::timeOps(chunks, [&](size_t c) {
+            arr.push_bulk((const int*)keys.data() + c * CHUNK, min(CHUNK, n - c * CHUNK));
+        });
+        pushBulk.nsPerOp = pushBulk.nsPerOp * chunks / n;
+        pushBulk.p99Ns /= CHUNK;
+        pushBulk.allocsPerOp = pushBulk.allocsPerOp * chunks / n;
+        bench::printRow("push_bulk (1024)", bench::UNIFORM, n, -1, pushBulk,
+                        (double)arr.capacity() * sizeof(int) / n);
     }
-    sz--;
-    if (sz > 0 && sz <= cap / 4) resize(cap / 2);
-    show();
 }
 
-int main() {
-    arr = new int[1];
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        size_t maxSize = argc > 2 ? stoul(argv[2]) : 10000000;
+        runBenchmark(maxSize);
+        runSuite(maxSize);
+        return 0;
+    }
+    
+    DynamicArray<int> arr;
     
     cout << "Dynamic Array Operations:\n";
     cout << "1. Push value\n";
     cout << "2. Pop value\n";
     cout << "3. Show array\n";
-    cout << "4. Exit\n\n";
+    cout << "4. Push n values\n";
+    cout << "5. Pop n values\n";
+    cout << "6. Exit\n\n";
     
     while (true) {
         cout << "Enter choice: ";
@@ -57,12 +144,28 @@ int main() {
             cout << "Enter value: ";
             int x;
             cin >> x;
-            push(x);
+            arr.push_back(x);
+            show(arr);
         } else if (choice == 2) {
-            pop();
+            if (arr.pop_back()) show(arr);
+            else cout << "Array is empty!\n";
         } else if (choice == 3) {
-            show();
+            show(arr);
         } else if (choice == 4) {
+            cout << "Enter n and the values: ";
+            size_t n;
+            cin >> n;
+            vector<int> values(n);
+            for (int& x : values) cin >> x;
+            arr.push_bulk(values.data(), n);
+            show(arr);
+        } else if (choice == 5) {
+            cout << "Enter n: ";
+            size_t n;
+            cin >> n;
+            if (arr.pop_bulk(n) < n) cout << "Array had fewer than " << n << " values\n";
+            show(arr);
+        } else if (choice == 6) {
             break;
         } else {
             cout << "Invalid choice!\n";
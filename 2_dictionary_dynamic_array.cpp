@@ -1,68 +1,457 @@
 #include <bits/stdc++.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "dynamic_array.h"
+#include "bench_util.h"
+#include "bulk_load.h"
 using namespace std;
 
+uint32_t hashKey(string_view k) {
+    uint64_t h = hash<string_view>{}(k);
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+#ifdef ARENA_KEYS
+// Compile with -DARENA_KEYS to intern keys instead of giving each entry a
+// std::string. Keys up to INLINE_KEY bytes live in the entry itself; longer
+// ones are appended to one bump-pointer arena and referenced by offset, so
+// growing the arena never invalidates them. Entries are trivially copyable
+// and teardown is a single free.
+const uint32_t INLINE_KEY = 12;
+
+struct Entry {
+    uint32_t hash;
+    uint32_t len;
+    int value;
+    char text[INLINE_KEY];  // The key, or its 8-byte arena offset
+};
+
+char *arena = nullptr;
+size_t arenaUsed = 0, arenaCap = 0, arenaDead = 0;
+
+const char *keyData(const Entry &e) {
+    if (e.len <= INLINE_KEY) return e.text;
+    uint64_t offset;
+    memcpy(&offset, e.text, sizeof(offset));
+    return arena + offset;
+}
+
+string_view keyView(const Entry &e) {
+    return string_view(keyData(e), e.len);
+}
+
+uint32_t entryHash(const Entry &e) {
+    return e.hash;
+}
+
+// Cached hash and length reject almost every mismatch before the bytes
+bool keyEquals(const Entry &e, string_view k, uint32_t h) {
+    return e.hash == h && e.len == k.size() && memcmp(keyData(e), k.data(), k.size()) == 0;
+}
+
+Entry makeEntry(string k, uint32_t h, int v) {
+    Entry e;
+    e.hash = h;
+    e.len = k.size();
+    e.value = v;
+    if (e.len <= INLINE_KEY) {
+        memcpy(e.text, k.data(), k.size());
+        return e;
+    }
+    if (arenaUsed + k.size() > arenaCap) {
+        size_t newCap = max(arenaUsed + k.size(), arenaCap * 2);
+        // On failure realloc leaves the old arena alive: keep it and throw
+        char *grown = static_cast<char *>(realloc(arena, newCap));
+        if (!grown) throw bad_alloc();
+        arena = grown;
+        arenaCap = newCap;
+    }
+    uint64_t offset = arenaUsed;
+    memcpy(arena + offset, k.data(), k.size());
+    memcpy(e.text, &offset, sizeof(offset));
+    arenaUsed += k.size();
+    return e;
+}
+
+// An erased long key leaves dead bytes in the arena
+void releaseKey(const Entry &e) {
+    if (e.len > INLINE_KEY) arenaDead += e.len;
+}
+#else
 struct Entry {
     string key;
     int value;
 };
 
-Entry *arr;
-int sz = 0, cap = 1;
+string_view keyView(const Entry &e) {
+    return e.key;
+}
+
+uint32_t entryHash(const Entry &e) {
+    return hashKey(e.key);
+}
+
+bool keyEquals(const Entry &e, string_view k, uint32_t) {
+    return e.key == k;
+}
+
+Entry makeEntry(string k, uint32_t, int v) {
+    return {move(k), v};
+}
+
+void releaseKey(const Entry &) {}
+#endif
+
+// Dense entry storage and iteration order. DynamicArray relocates entries
+// by move on growth and shrink, so keys are never deep-copied.
+DynamicArray<Entry> arr;
+
+// Copy the live long keys into a fresh arena once dead bytes outweigh them
+void compactKeys() {
+#ifdef ARENA_KEYS
+    if (arenaDead <= 4096 || arenaDead * 2 <= arenaUsed) return;
+    size_t live = arenaUsed - arenaDead;
+    char *fresh = static_cast<char *>(malloc(max<size_t>(1, live)));
+    if (!fresh) return;  // Compaction is optional: keep the old arena
+    size_t used = 0;
+    for (size_t i = 0; i < arr.size(); i++) {
+        if (arr[i].len <= INLINE_KEY) continue;
+        memcpy(fresh + used, keyData(arr[i]), arr[i].len);
+        uint64_t offset = used;
+        memcpy(arr[i].text, &offset, sizeof(offset));
+        used += arr[i].len;
+    }
+    free(arena);
+    arena = fresh;
+    arenaCap = max<size_t>(1, live);
+    arenaUsed = used;
+    arenaDead = 0;
+#endif
+}
+
+// Operations are silent and report status. Build with -DTRACE_OPS to print
+// the dictionary after every mutation (debugging only: O(n) output per call).
+#ifdef TRACE_OPS
+#define TRACE() show()
+#else
+#define TRACE()
+#endif
 
 void show() {
-    cout << "sz=" << sz << " cap=" << cap << " [";
-    for (int i = 0; i < sz; i++) {
-        cout << "(" << arr[i].key << ":" << arr[i].value << ")";
-        if (i < sz - 1) cout << ",";
+    cout << "sz=" << arr.size() << " cap=" << arr.capacity() << " [";
+    for (size_t i = 0; i < arr.size(); i++) {
+        cout << "(" << keyView(arr[i]) << ":" << arr[i].value << ")";
+        if (i + 1 < arr.size()) cout << ",";
     }
     cout << "]\n";
 }
 
-void resizeArr(int newCap) {
-    Entry *newArr = new Entry[newCap];
-    for (int i = 0; i < sz; i++) newArr[i] = arr[i];
-    delete[] arr;
-    arr = newArr;
-    cap = newCap;
+// Robin Hood open-addressing index over arr: each slot holds a position in
+// arr (-1 = empty) and the key's hash, so probes skip most string compares
+// and the index can be rebuilt without rehashing keys. idxCap is a power of 2.
+// Small dictionaries have no index (see small mode below).
+struct Slot {
+    int pos;
+    uint32_t hash;
+};
+
+Slot *idx = nullptr;
+int idxCap = 0;
+bool indexed = false;
+
+// How far slot i is from its key's home slot
+int probeDist(int i) {
+    return (i - (int)(idx[i].hash & (idxCap - 1))) & (idxCap - 1);
 }
 
-int findIndex(const string &k) {
-    for (int i = 0; i < sz; i++) if (arr[i].key == k) return i;
+void indexInsert(int pos, uint32_t h) {
+    Slot cur = {pos, h};
+    int mask = idxCap - 1;
+    for (int i = h & mask, d = 0;; i = (i + 1) & mask, d++) {
+        if (idx[i].pos == -1) {
+            idx[i] = cur;
+            return;
+        }
+        // Take the slot from an entry closer to home, then keep placing it
+        int other = probeDist(i);
+        if (other < d) {
+            swap(cur, idx[i]);
+            d = other;
+        }
+    }
+}
+
+void resizeIndex(int newCap) {
+    Slot *old = idx;
+    int oldCap = idxCap;
+    idx = new Slot[newCap];
+    idxCap = newCap;
+    for (int i = 0; i < newCap; i++) idx[i].pos = -1;
+    for (int i = 0; i < oldCap; i++) if (old[i].pos != -1) indexInsert(old[i].pos, old[i].hash);
+    delete[] old;
+}
+
+// Index slot whose entry matches: the key k, or position pos if k is null
+int findSlot(const string *k, uint32_t h, int pos = -1) {
+    int mask = idxCap - 1;
+    for (int i = h & mask, d = 0;; i = (i + 1) & mask, d++) {
+        if (idx[i].pos == -1 || probeDist(i) < d) return -1;
+        if (idx[i].hash != h) continue;
+        if (k ? keyEquals(arr[idx[i].pos], *k, h) : idx[i].pos == pos) return i;
+    }
+}
+
+// Backward-shift deletion: pull following entries one slot towards home
+void indexErase(int i) {
+    int mask = idxCap - 1;
+    for (int next = (i + 1) & mask; idx[next].pos != -1 && probeDist(next) > 0; next = (next + 1) & mask) {
+        idx[i] = idx[next];
+        i = next;
+    }
+    idx[i].pos = -1;
+}
+
+// Small mode: up to SMALL_MAX entries there is no index. Each entry's top
+// hash byte and length (capped at 255) sit in two parallel arrays, so a
+// lookup filters every entry with a few byte compares (32 per compare with
+// AVX2, 16 with SSE2) and only compares keys whose tag and length match.
+// The index is built once the dictionary outgrows SMALL_MAX and dropped
+// again when erases bring it down to SMALL_MAX / 2.
+const int SMALL_MAX = 32;
+static_assert(SMALL_MAX == 32, "candidate masks are 32 bits wide");
+alignas(32) uint8_t smallTags[SMALL_MAX];
+alignas(32) uint8_t smallLens[SMALL_MAX];
+
+uint8_t hashTag(uint32_t h) {
+    return h >> 24;
+}
+
+uint8_t lengthTag(size_t len) {
+    return len < 255 ? len : 255;
+}
+
+void setSmallTags(int i, uint32_t h, size_t len) {
+    smallTags[i] = hashTag(h);
+    smallLens[i] = lengthTag(len);
+}
+
+// Bit i set if entry i's tag and length match
+uint32_t smallCandidates(uint8_t tag, uint8_t len) {
+    uint32_t mask = 0;
+#if defined(__AVX2__)
+    __m256i tags = _mm256_load_si256((const __m256i *)smallTags);
+    __m256i lens = _mm256_load_si256((const __m256i *)smallLens);
+    __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(tags, _mm256_set1_epi8(tag)),
+                                   _mm256_cmpeq_epi8(lens, _mm256_set1_epi8(len)));
+    mask = _mm256_movemask_epi8(hit);
+#elif defined(__SSE2__)
+    for (int half = 0; half < SMALL_MAX; half += 16) {
+        __m128i tags = _mm_load_si128((const __m128i *)(smallTags + half));
+        __m128i lens = _mm_load_si128((const __m128i *)(smallLens + half));
+        __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(tags, _mm_set1_epi8(tag)),
+                                    _mm_cmpeq_epi8(lens, _mm_set1_epi8(len)));
+        mask |= (uint32_t)_mm_movemask_epi8(hit) << half;
+    }
+#else
+    for (int i = 0; i < SMALL_MAX; i++) mask |= (uint32_t)(smallTags[i] == tag && smallLens[i] == len) << i;
+#endif
+    // Tags past the last entry are stale
+    return arr.size() >= 32 ? mask : mask & ((1u << arr.size()) - 1);
+}
+
+int smallFind(string_view k, uint32_t h) {
+    for (uint32_t mask = smallCandidates(hashTag(h), lengthTag(k.size())); mask; mask &= mask - 1) {
+        int i = __builtin_ctz(mask);
+        if (keyEquals(arr[i], k, h)) return i;
+    }
     return -1;
 }
 
-void setKV(const string &k, int v) {
-    int idx = findIndex(k);
-    if (idx != -1) {
-        arr[idx].value = v;
-    } else {
-        if (sz == cap) resizeArr(max(1, cap * 2));
-        arr[sz++] = {k, v};
+// Index capacity keeping n entries under 3/4 load
+int indexCapFor(size_t n) {
+    int cap = 8;
+    while (n * 4 > (size_t)cap * 3) cap *= 2;
+    return cap;
+}
+
+// Leave small mode: index every entry in a table of cap slots
+void buildIndex(int cap) {
+    resizeIndex(cap);
+    for (size_t i = 0; i < arr.size(); i++) indexInsert(i, entryHash(arr[i]));
+    indexed = true;
+}
+
+// Back to small mode: drop the index and tag every entry
+void dropIndex() {
+    delete[] idx;
+    idx = nullptr;
+    idxCap = 0;
+    indexed = false;
+    for (size_t i = 0; i < arr.size(); i++) setSmallTags(i, entryHash(arr[i]), keyView(arr[i]).size());
+}
+
+int findIndex(const string &k) {
+    uint32_t h = hashKey(k);
+    if (!indexed) return smallFind(k, h);
+    int s = findSlot(&k, h);
+    return s == -1 ? -1 : idx[s].pos;
+}
+
+// Takes the key by value so callers can move temporaries in. Returns true if
+// the key was added, false if an existing value was overwritten.
+bool setKV(string k, int v) {
+    uint32_t h = hashKey(k);
+    int i = indexed ? findSlot(&k, h) : smallFind(k, h);
+    if (i != -1) {
+        arr[indexed ? idx[i].pos : i].value = v;
+        TRACE();
+        return false;
     }
-    show();
+    if (!indexed && arr.size() == SMALL_MAX) buildIndex(indexCapFor(SMALL_MAX + 1));
+    if (!indexed) {
+        setSmallTags(arr.size(), h, k.size());
+        arr.push_back(makeEntry(move(k), h, v));
+        TRACE();
+        return true;
+    }
+    if ((arr.size() + 1) * 4 > (size_t)idxCap * 3) resizeIndex(idxCap * 2);
+    arr.push_back(makeEntry(move(k), h, v));
+    indexInsert(arr.size() - 1, h);
+    TRACE();
+    return true;
 }
 
-void eraseKV(const string &k) {
-    int idx = findIndex(k);
-    if (idx == -1) {
-        cout << "Key not found\n";
-        return;
+// Returns false if the key is not present
+bool eraseKV(const string &k) {
+    uint32_t h = hashKey(k);
+    int s = -1, i;
+    if (indexed) {
+        s = findSlot(&k, h);
+        i = s == -1 ? -1 : idx[s].pos;
+    } else {
+        i = smallFind(k, h);
     }
-    arr[idx] = arr[sz - 1];
-    sz--;
-    if (sz > 0 && sz <= cap / 4) resizeArr(max(1, cap / 2));
-    show();
+    if (i == -1) return false;
+    if (indexed) indexErase(s);
+    releaseKey(arr[i]);
+    // The last entry moves into the hole: repoint its one index slot, or its tags
+    int last = arr.size() - 1;
+    if (i != last) {
+        if (indexed) {
+            idx[findSlot(nullptr, entryHash(arr[last]), last)].pos = i;
+        } else {
+            smallTags[i] = smallTags[last];
+            smallLens[i] = smallLens[last];
+        }
+        arr[i] = move(arr[last]);
+    }
+    arr.pop_back();
+    compactKeys();
+    if (indexed && arr.size() <= SMALL_MAX / 2) dropIndex();
+    else if (idxCap > 8 && arr.size() * 8 < (size_t)idxCap) resizeIndex(idxCap / 2);
+    TRACE();
+    return true;
+}
+
+// Value stored under k, or nullptr if the key is not present
+const int *getKV(const string &k) {
+    int i = findIndex(k);
+    return i == -1 ? nullptr : &arr[i].value;
+}
+
+// Bulk load "key value" lines from path ("-" for stdin). Each chunk's
+// records are applied with setKV after sizing the index and entry storage
+// once for the whole batch, so a load never grows them one key at a time.
+bulk::LoadStats loadKV(const char *path) {
+    return bulk::readKeyValues(path, [](const vector<bulk::KeyValue> &batch) {
+        size_t needed = arr.size() + batch.size();
+        if (needed > (size_t)SMALL_MAX) {
+            int newCap = max(idxCap, indexCapFor(needed));
+            if (!indexed) buildIndex(newCap);
+            else if (newCap != idxCap) resizeIndex(newCap);
+        }
+        if (needed > arr.capacity()) arr.reserve(max(needed, arr.capacity() * 2));
+        for (const bulk::KeyValue &kv : batch) setKV(string(kv.key), kv.value);
+    });
 }
 
-void getKV(const string &k) {
-    int idx = findIndex(k);
-    if (idx == -1) cout << "Key not found\n";
-    else cout << arr[idx].value << "\n";
+// Heap bytes held by the dictionary, given the counted heap growth since it
+// was empty; the arena and trivially copyable entry storage bypass the count
+size_t dictionaryBytes(size_t heapDelta) {
+#ifdef ARENA_KEYS
+    return heapDelta + arr.capacity() * sizeof(Entry) + arenaCap;
+#else
+    return heapDelta;
+#endif
 }
 
-int main() {
+// setKV/getKV/eraseKV at SMALL_MAX and every size up to maxSize for each
+// key distribution; lookups run at 100%, 50% and 0% hits
+void runBenchmark(size_t maxSize) {
+    const size_t LOOKUPS = 1000000;
+    bench::Distribution dists[] = {bench::UNIFORM, bench::ZIPF, bench::ADVERSARIAL};
+    volatile long long sink = 0;
+    
+    // SMALL_MAX entries first: the largest dictionary served without an index
+    vector<size_t> sizes = bench::benchSizes(maxSize);
+    sizes.insert(sizes.begin(), SMALL_MAX);
+    
+    cout << "Dictionary (string->int) operations\n";
+    bench::printHeader();
+    for (size_t n : sizes) {
+        for (bench::Distribution d : dists) {
+            vector<uint32_t> ids = bench::makeKeys(n, d);
+            vector<string> keys(n);
+            for (size_t i = 0; i < n; i++) keys[i] = bench::keyString(ids[i], d);
+            
+            size_t heapBefore = bench::AllocStats::liveBytes;
+            bench::Result insert = bench::timeOps(n, [&](size_t i) { setKV(keys[i], i); });
+            double bytesPerKey = bench::COUNTS_ALLOCS ? (double)dictionaryBytes(bench::AllocStats::liveBytes - heapBefore) / n : -1;
+            bench::printRow("setKV (insert)", d, n, -1, insert, bytesPerKey);
+            
+            for (int hitPercent : {100, 50, 0}) {
+                vector<uint32_t> probeIds = bench::makeProbes(ids, d, LOOKUPS, hitPercent / 100.0);
+                vector<string> probes(LOOKUPS);
+                for (size_t j = 0; j < LOOKUPS; j++) probes[j] = bench::keyString(probeIds[j], d);
+                bench::Result get = bench::timeOps(LOOKUPS, [&](size_t j) {
+                    const int *v = getKV(probes[j]);
+                    if (v) sink = sink + *v;
+                });
+                bench::printRow("getKV", d, n, hitPercent, get, bytesPerKey);
+            }
+            
+            bench::Result update = bench::timeOps(n, [&](size_t i) { setKV(keys[i], -(int)i); });
+            bench::printRow("setKV (update)", d, n, -1, update, -1);
+            
+            bench::Result erase = bench::timeOps(n, [&](size_t i) { eraseKV(keys[i]); });
+            bench::printRow("eraseKV", d, n, -1, erase, -1);
+        }
+    }
+}
 
-    arr = new Entry[1];
+int main(int argc, char **argv) {
+
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        runBenchmark(argc > 2 ? stoul(argv[2]) : 1000000);
+        delete[] idx;
+        return 0;
+    }
+
+    // --load <file|->: bulk load "key value" lines, then take commands
+    if (argc > 2 && string(argv[1]) == "--load") {
+        auto start = chrono::steady_clock::now();
+        bulk::LoadStats stats = loadKV(argv[2]);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (!stats.opened) {
+            cout << "Cannot open " << argv[2] << "\n";
+            delete[] idx;
+            return 1;
+        }
+        cout << "Loaded " << stats.records << " records (" << arr.size() << " keys, "
+             << stats.skipped << " malformed lines skipped) in " << fixed << setprecision(1) << ms << " ms, "
+             << stats.bytes / max(1e-3, ms) / 1e3 << " MB/s\n";
+    }
 
     cout << "Dictionary (string->int) using dynamic array\n";
     cout << "1: set key value\n2: get key\n3: erase key\n4: show\n5: exit\n";
@@ -73,11 +462,17 @@ int main() {
         if (!(cin >> cmd)) break;
         if (cmd == 1) {
             string k; int v; cin >> k >> v;
-            setKV(k, v);
+            setKV(move(k), v);
+            show();
         } else if (cmd == 2) {
-            string k; cin >> k; getKV(k);
+            string k; cin >> k;
+            const int *v = getKV(k);
+            if (v) cout << *v << "\n";
+            else cout << "Key not found\n";
         } else if (cmd == 3) {
-            string k; cin >> k; eraseKV(k);
+            string k; cin >> k;
+            if (eraseKV(k)) show();
+            else cout << "Key not found\n";
         } else if (cmd == 4) {
             show();
         } else if (cmd == 5) {
@@ -87,6 +482,9 @@ int main() {
         }
     }
 
-    delete[] arr;
+    delete[] idx;
+#ifdef ARENA_KEYS
+    free(arena);
+#endif
     return 0;
 }
@@ -1,4 +1,23 @@
 #include <bits/stdc++.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <linux/membarrier.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "bench_util.h"
+#include "bulk_load.h"
 using namespace std;
 
 /*
@@ -10,193 +29,2792 @@ using namespace std;
     Level 1: Primary hash table with n buckets using a universal hash function
     Level 2: For each bucket k, create a secondary hash table of size k²
              to ensure collision-free hashing within that bucket
+    
+    A bucket whose k² table finds no collision-free function in 100 tries
+    retries in tables of 2k², 4k² and 8k², and whatever still collides on
+    the last try goes to a small per-bucket stash scanned after the slot.
+    A build therefore always succeeds within a fixed number of attempts.
+*/
+
+/*
+    Epoch-based reclamation for wait-free readers
+    
+    Every reader thread owns one announcement slot. Entering a read stores the
+    current global epoch there and leaving clears it, so a lookup never blocks,
+    retries or takes a lock. A writer that unpublishes an object tags it with
+    the epoch it was retired in and frees it only once every active slot has
+    moved past that epoch. A stale (older) announcement only delays frees.
+    
+    The announcement must be visible before the reader loads any pointer. On
+    Linux the writer issues membarrier(PRIVATE_EXPEDITED) before scanning the
+    slots, which lets readers get away with a plain store; elsewhere readers
+    pay for a full fence.
 */
+class EpochDomain {
+public:
+    static const uint64_t IDLE = UINT64_MAX;
+    static const int MAX_READERS = 256;
+    
+    static EpochDomain& global() {
+        static EpochDomain domain;
+        return domain;
+    }
+    
+    // Scope of one read; nests safely inside another read on the same thread
+    class ReadGuard {
+        atomic<uint64_t>& slot;
+        bool outermost;
+        
+    public:
+        ReadGuard() : slot(global().threadSlot()) {
+            outermost = slot.load(memory_order_relaxed) == IDLE;
+            if (!outermost) return;
+            
+            EpochDomain& domain = global();
+            slot.store(domain.epoch.load(memory_order_relaxed), memory_order_relaxed);
+            if (domain.asymmetricFence) atomic_signal_fence(memory_order_seq_cst);
+            else atomic_thread_fence(memory_order_seq_cst);
+        }
+        
+        ~ReadGuard() {
+            if (outermost) slot.store(IDLE, memory_order_release);
+        }
+    };
+    
+    // Called by a writer right after unpublishing: returns the epoch to tag the
+    // unpublished object with and opens the next epoch for new readers
+    uint64_t retire() { return epoch.fetch_add(1); }
+    
+    // Make every reader's announcement visible to the scan in safeToFree
+    void synchronize() const {
+#ifdef __linux__
+        if (asymmetricFence) {
+            syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+            return;
+        }
+#endif
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+    
+    // An object retired in epoch `tag` is unreachable once no reader still
+    // announces an epoch <= tag
+    bool safeToFree(uint64_t tag) const {
+        int used = highWater.load(memory_order_acquire);
+        for (int i = 0; i < used; i++) {
+            if (slots[i].epoch.load(memory_order_seq_cst) <= tag) return false;
+        }
+        return true;
+    }
+    
+private:
+    struct alignas(64) Slot {
+        atomic<uint64_t> epoch{IDLE};
+        atomic<bool> owned{false};
+    };
+    
+    // Releases the calling thread's slot when the thread exits
+    struct SlotLease {
+        Slot* slot = nullptr;
+        ~SlotLease() { if (slot) slot->owned.store(false, memory_order_release); }
+    };
+    
+    atomic<uint64_t> epoch{0};
+    atomic<int> highWater{0};
+    bool asymmetricFence = false;
+    Slot slots[MAX_READERS];
+    
+    EpochDomain() {
+#ifdef __linux__
+        asymmetricFence = syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#endif
+    }
+    
+    // The trivially destructible pointer keeps the hot path free of TLS
+    // initialization checks; the lease is only touched on first use
+    atomic<uint64_t>& threadSlot() {
+        static thread_local Slot* slot = nullptr;
+        if (__builtin_expect(slot == nullptr, 0)) {
+            static thread_local SlotLease lease;
+            lease.slot = slot = claimSlot();
+        }
+        return slot->epoch;
+    }
+    
+    // More than MAX_READERS concurrent reader threads wait here for a free slot
+    Slot* claimSlot() {
+        while (true) {
+            for (int i = 0; i < MAX_READERS; i++) {
+                if (slots[i].owned.load(memory_order_relaxed)) continue;
+                if (slots[i].owned.exchange(true, memory_order_acquire)) continue;
+                
+                int used = highWater.load(memory_order_relaxed);
+                while (used < i + 1 && !highWater.compare_exchange_weak(used, i + 1)) {}
+                return &slots[i];
+            }
+            this_thread::yield();
+        }
+    }
+};
+
+// SplitMix64 (Steele, Lea, Flood): a fast 64-bit generator with one word of
+// state, cheap enough to give every table and every bucket build its own
+struct SplitMix64 {
+    uint64_t state;
+    
+    constexpr explicit SplitMix64(uint64_t seed) : state(seed) {}
+    
+    constexpr uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+// Multiply-shift hash of a 32-bit key reduced to [0, tableSize) with fast
+// range: ((a*x + b) mod 2^64) >> 32, then (h * m) >> 32
+constexpr uint32_t multiplyShift(int key, uint64_t a, uint64_t b, uint32_t tableSize) {
+    uint64_t h = (a * (uint32_t)key + b) >> 32;
+    return (h * tableSize) >> 32;
+}
+
+class PerfectHashing {
+public:
+    // Universal families selectable per table. Both are reduced to the table
+    // size inside hashFunction, so call sites never apply their own modulo.
+    enum HashFamily {
+        MODULO_PRIME,    // ((a*x + b) mod p) mod m: two 64-bit divisions
+        MULTIPLY_SHIFT   // ((a*x + b) >> 32) reduced by fast range: no division
+    };
+    
+private:
+    // Marks an unused or erased slot. The key -1 is therefore never placed
+    // in a table: holdsMinusOne records it, and lookups for -1 read the flag.
+    static constexpr int EMPTY_SLOT = -1;
+    
+    struct SecondaryTable {
+        vector<int> table;
+        vector<int> stash;  // Keys the final fallback function could not place
+        int size;
+        uint64_t a, b;  // Hash function parameters
+        
+        SecondaryTable() : size(0), a(0), b(0) {}
+    };
+    
+    // Frozen per-bucket header: 32 bytes aligned, so it never straddles a cache
+    // line and a lookup touches one header line plus one slot line. A bucket
+    // with a one-slot table keeps that slot in the header itself, so lookups
+    // landing there (about a third of them) touch the header line only.
+    struct alignas(32) BucketHeader {
+        uint64_t a, b;    // Level 2 parameters
+        uint32_t offset;  // First slot of this bucket in `slots` (unused when size <= 1)
+        uint32_t size;    // Secondary table size (0 for an empty bucket)
+        uint32_t stashSize;  // Stashed keys, stored right after the table's slots
+        int inlineKey;    // The slot of a one-slot table (EMPTY_SLOT once erased)
+    };
+    
+    // Everything a reader needs, published as one unit. A writer never edits
+    // a published directory except to swap in a rebuilt secondary table, and
+    // replaces the whole directory on a global rehash, freeze or thaw.
+    struct Directory {
+        int primarySize;
+        uint64_t a1, b1;  // Level 1 hash function parameters
+        bool frozen;
+        
+        // Dynamic layout: one table per bucket (null when empty), owned here
+        unique_ptr<atomic<const SecondaryTable*>[]> tables;
+        
+        // Frozen layout: all secondary tables packed into one slot array.
+        // Readers go through the pointers, which address the stores below,
+        // a read-only file mapping or a huge page region kept alive by `mapping`.
+        const BucketHeader* headers = nullptr;
+        const int* slots = nullptr;
+        size_t slotCount = 0;
+        vector<BucketHeader> headerStore;
+        vector<int> slotStore;
+        shared_ptr<const void> mapping;
+        bool hugePages = false;  // `mapping` is a huge page region (setHugePageLayout)
+        
+        // Per NUMA node copies of a frozen layout, indexed by node; readers
+        // on a node without one (null) use this directory's own layout
+        vector<unique_ptr<Directory>> replicas;
+        
+        // Without clearTables the caller nulls every table pointer before use
+        Directory(int n, uint64_t a, uint64_t b, bool isFrozen, bool clearTables = true)
+            : primarySize(n), a1(a), b1(b), frozen(isFrozen) {
+            if (frozen) return;
+            tables.reset(new atomic<const SecondaryTable*>[primarySize]);
+            if (!clearTables) return;
+            for (int i = 0; i < primarySize; i++) tables[i].store(nullptr, memory_order_relaxed);
+        }
+        
+        ~Directory() {
+            if (!tables) return;
+            for (int i = 0; i < primarySize; i++) delete tables[i].load(memory_order_relaxed);
+        }
+    };
+    
+    // Keys inserted in incremental mode whose secondary table has not been
+    // rebuilt yet. Append-only: the writer fills keys[count] and then
+    // publishes count, so readers scan keys[0, count) without locking. Once
+    // keys are placed the buffer is replaced by one holding the rest.
+    struct PendingBuffer {
+        static const int CAPACITY = 64;
+        int keys[CAPACITY];
+        atomic<int> count{0};
+    };
+    
+    // An unpublished object waiting for readers of its epoch to finish
+    struct Retired {
+        uint64_t epoch;
+        const SecondaryTable* table;
+        const Directory* directory;
+        const PendingBuffer* buffer;
+    };
+    
+    vector<vector<int>> buckets;        // Level 1: Primary buckets (writer only)
+    atomic<Directory*> directory;       // Level 2: published secondary tables
+    vector<Retired> retired;
+    
+    atomic<PendingBuffer*> pending{nullptr};  // Incremental mode only
+    atomic<bool> holdsMinusOne{false};        // Key -1 stored (see EMPTY_SLOT)
+    
+    HashFamily family;
+    
+    int totalKeys;
+    long long sumSquares;  // sum of k² over all buckets = total secondary slots
+    int rehashCount;
+    bool bucketsDropped;
+    int buildThreads;  // Workers used by rehash for large key sets
+    uint64_t seed;     // Seed the generator started from, for reproducing a build
+    SplitMix64 rng;    // Per-instance source of hash function parameters
+    
+    const long long MOD = 1e9 + 7;
+    const long long PRIME = 2147483647LL; // Large prime for universal hashing
+    const int SUM_SQUARES_FACTOR = 4;     // FKS space bound: sum(k²) <= c·n
+    const size_t RECLAIM_BATCH = 64;      // Retired tables per reclamation pass
+    const int PARALLEL_BUILD_MIN_KEYS = 1 << 15;  // Below this a rehash runs on one thread
+    const int SECONDARY_ATTEMPTS = 100;   // Level 2 functions tried at size k²
+    const int GROWTH_ROUNDS = 3;          // Then at 2k², 4k² and 8k²...
+    const int GROWTH_ATTEMPTS = 8;        // ...with this many functions each
+    const int SECONDARY_SHRINK_FACTOR = 4;  // Rebuild a table once 4·live² < its size
+    const int PRIMARY_SHRINK_FACTOR = 4;    // Rehash to 2n once n < buckets / 4
+    const long long REBUILD_STEP_UNITS = 1024;  // Keys or slots handled per incremental step
+    const size_t FREE_STEP_BYTES = 1 << 16;     // Retired tables and key lists freed per step
+    const long long REPLAY_ALLOC_UNITS = 32;    // Step units charged for a replayed key's table swap
+    static const int MAX_NUMA_NODES = 64;       // Node ids probed in sysfs
+    static const unsigned NODE_REFRESH_CALLS = 4096;  // Lookups between node checks
+    
+public:
+    // Outcome of a bulk build or global rehash, for programs rather than
+    // people: totals, a per-bucket record of what Level 2 had to do, and
+    // (with setBuildProfiling) where the time went. Times are summed over
+    // workers, so on a parallel build they can exceed the wall time.
+    struct BuildReport {
+        int keys;
+        int primaryRetries;    // Level 1 functions rejected for sum of k² > 4n
+        int secondaryRetries;  // Level 2 functions rejected for collisions
+        int stashedBuckets;    // Buckets that fell back to a stash
+        int stashedKeys;       // Keys held in those stashes
+        int grownBuckets;      // Buckets whose table grew past k²
+        int threads;           // Workers the build ran on
+        double milliseconds;
+        
+        vector<int> bucketAttempts;       // Rejected Level 2 functions, per bucket
+        vector<int> stashedBucketIds;     // Buckets that exhausted every size
+        vector<int> bucketSizeHistogram;  // [k] = number of buckets holding k keys
+        long long totalSlots;             // Secondary slots allocated, stashes excluded
+        long long occupiedSlots;          // Slots holding a key
+        double hashingMs;                 // Computing Level 1 and 2 hashes
+        double collisionCheckMs;          // Testing Level 2 candidates for collisions
+        
+        BuildReport() : keys(0), primaryRetries(0), secondaryRetries(0),
+                        stashedBuckets(0), stashedKeys(0), grownBuckets(0), threads(1), milliseconds(0),
+                        totalSlots(0), occupiedSlots(0), hashingMs(0), collisionCheckMs(0) {}
+    };
+    
+private:
+    // Level 2 time split, accumulated per worker while profiling
+    struct PhaseTimes {
+        double hashingNs = 0;
+        double checkingNs = 0;
+    };
+    
+    BuildReport lastReport;
+    function<void(const BuildReport&)> buildObserver;
+    bool profileBuild;
+    
+    // A global rehash spread over many rebuildStep calls. The phases run in
+    // order and each step advances them by about REBUILD_STEP_UNITS keys,
+    // buckets or slots. Keys inserted meanwhile go to the old directory as
+    // usual and to `log`, which is replayed into the new one before it is
+    // published.
+    struct RehashJob {
+        enum Phase { COLLECTING, CLEARING, COUNTING, SIZING, PARTITIONING, BUILDING, REPLAYING };
+        Phase phase = COLLECTING;
+        int primarySize = 0;
+        uint64_t a1 = 0, b1 = 0;  // Level 1 candidate
+        uint64_t buildSeed = 0;
+        size_t cursor = 0;        // Progress within the phase
+        int attempt = 0;
+        long long sumSquares = 0;
+        int placedKeys = 0;
+        vector<int> keys;         // Snapshot of the old buckets
+        vector<uint32_t> bucketOf;
+        vector<int> counts;
+        vector<vector<int>> buckets;
+        unique_ptr<Directory> next;
+        vector<int> log;
+        BuildReport report;
+        chrono::steady_clock::time_point start;
+        
+        // Table pointers past the cleared slice are garbage until SIZING ends
+        ~RehashJob() {
+            if (!next || phase != SIZING) return;
+            for (size_t i = cursor; i < (size_t)primarySize; i++) next->tables[i].store(nullptr, memory_order_relaxed);
+        }
+    };
+    
+    // A reclaimed directory whose tables are freed a slice per step
+    struct Grave {
+        Directory* dir;
+        int cursor;
+    };
+    
+    // Incremental mode state (writer only)
+    bool incremental = false;
+    deque<int> dirtyBuckets;   // Buckets with keys in `pending`; never more than its CAPACITY
+    unique_ptr<RehashJob> job;
+    vector<Grave> graveyard;
+    vector<vector<int>> staleBuckets;  // Key lists of the last rehash, freed a slice per step
+    
+    bool hugePageLayout = false;  // Freeze into one huge page region
+    bool numaReplication = false;  // Copy frozen layouts to every NUMA node
+    
+public:
+    
+    // Tables built from the same seed, keys and insert order are identical,
+    // whatever the build thread count
+    PerfectHashing(int n = 10, HashFamily hashFamily = MULTIPLY_SHIFT, uint64_t seedValue = randomSeed())
+        : directory(nullptr), family(hashFamily), totalKeys(0), sumSquares(0),
+          rehashCount(0), bucketsDropped(false), buildThreads(defaultBuildThreads()),
+          seed(seedValue), rng(seedValue), profileBuild(false) {
+        int primarySize = max(1, n);
+        buckets.resize(primarySize);
+        
+        // Initialize Level 1 hash function randomly
+        uint64_t a1, b1;
+        randomizeHashFunction(a1, b1, rng);
+        directory.store(new Directory(primarySize, a1, b1, false));
+    }
+    
+    // Construct a static table over a known key set in one pass
+    PerfectHashing(const vector<int>& keys, HashFamily hashFamily = MULTIPLY_SHIFT,
+                   uint64_t seedValue = randomSeed())
+        : directory(nullptr), family(hashFamily), totalKeys(0), sumSquares(0),
+          rehashCount(0), bucketsDropped(false), buildThreads(defaultBuildThreads()),
+          seed(seedValue), rng(seedValue), profileBuild(false) {
+        build(keys);
+    }
+    
+    // Readers must have finished before the table is destroyed
+    ~PerfectHashing() {
+        delete directory.load();
+        delete pending.load();
+        for (const Retired& r : retired) {
+            delete r.table;
+            delete r.directory;
+            delete r.buffer;
+        }
+        for (const Grave& grave : graveyard) delete grave.dir;
+    }
+    
+    PerfectHashing(const PerfectHashing&) = delete;
+    PerfectHashing& operator=(const PerfectHashing&) = delete;
+    
+    // Universal hash function reduced to [0, tableSize).
+    // MODULO_PRIME:   h(x) = ((a*x + b) mod p) mod m, a in [1, p), b in [0, p)
+    // MULTIPLY_SHIFT: h(x) = ((a*x + b) mod 2^64) div 2^32 with random 64-bit a, b
+    //                 (Dietzfelbinger's multiply-add-shift, strongly universal on
+    //                 32-bit keys), mapped to m as (h*m) >> 32 (Lemire's fast range)
+    uint32_t hashFunction(int key, uint64_t a, uint64_t b, uint32_t tableSize) const {
+        uint64_t x = (uint32_t)key;
+        if (family == MODULO_PRIME) return ((a * x + b) % PRIME) % tableSize;
+        return multiplyShift(key, a, b, tableSize);
+    }
+    
+    // Generate random hash function parameters for the table's family. Every
+    // draw covers the full parameter range.
+    void randomizeHashFunction(uint64_t& a, uint64_t& b, SplitMix64& gen) const {
+        if (family == MODULO_PRIME) {
+            a = 1 + gen.next() % (PRIME - 1);
+            b = gen.next() % PRIME;
+            return;
+        }
+        a = gen.next();
+        b = gen.next();
+    }
+    
+    static uint64_t randomSeed() {
+        random_device entropy;
+        return ((uint64_t)entropy() << 32) ^ entropy();
+    }
+    
+    // Restart the generator; the next rebuild is reproducible from `seedValue`
+    void reseed(uint64_t seedValue) {
+        seed = seedValue;
+        rng = SplitMix64(seedValue);
+    }
+    
+    uint64_t seedUsed() const { return seed; }
+    
+    HashFamily hashFamily() const { return family; }
+    
+    // Occupancy bitmap reused by every collision check on the calling thread.
+    // It only ever grows and is left all-zero between checks.
+    static vector<uint64_t>& scratchBitmap() {
+        static thread_local vector<uint64_t> bits;
+        return bits;
+    }
+    
+    // Profiled collision check: hash every key first, then test the bitmap,
+    // so the two phases can be timed apart
+    bool isCollisionFreeTimed(const vector<int>& keys, uint64_t a, uint64_t b, int tableSize,
+                              PhaseTimes& times) const {
+        static thread_local vector<uint32_t> hashes;
+        vector<uint64_t>& bits = scratchBitmap();
+        size_t words = (tableSize + 63) / 64;
+        if (bits.size() < words) bits.resize(words, 0);
+        
+        auto start = chrono::steady_clock::now();
+        hashes.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++) hashes[i] = hashFunction(keys[i], a, b, tableSize);
+        auto hashed = chrono::steady_clock::now();
+        
+        size_t placed = 0;
+        for (; placed < hashes.size(); placed++) {
+            uint32_t h = hashes[placed];
+            uint64_t bit = 1ULL << (h & 63);
+            if (bits[h >> 6] & bit) break;
+            bits[h >> 6] |= bit;
+        }
+        for (size_t j = 0; j < placed; j++) bits[hashes[j] >> 6] &= ~(1ULL << (hashes[j] & 63));
+        auto checked = chrono::steady_clock::now();
+        
+        times.hashingNs += chrono::duration<double, nano>(hashed - start).count();
+        times.checkingNs += chrono::duration<double, nano>(checked - hashed).count();
+        return placed == hashes.size();
+    }
+    
+    // Check if hash function h is collision-free for given keys. After warm-up
+    // a failed attempt costs only hashing and bit tests, with no allocation.
+    bool isCollisionFree(const vector<int>& keys, uint64_t a, uint64_t b, int tableSize,
+                         PhaseTimes* times = nullptr) const {
+        if (times) return isCollisionFreeTimed(keys, a, b, tableSize, *times);
+        
+        vector<uint64_t>& bits = scratchBitmap();
+        size_t words = (tableSize + 63) / 64;
+        if (bits.size() < words) bits.resize(words, 0);
+        
+        size_t placed = 0;
+        bool collisionFree = true;
+        for (; placed < keys.size(); placed++) {
+            uint32_t h = hashFunction(keys[placed], a, b, tableSize);
+            uint64_t bit = 1ULL << (h & 63);
+            if (bits[h >> 6] & bit) {
+                collisionFree = false;
+                break;
+            }
+            bits[h >> 6] |= bit;
+        }
+        
+        // Restore the all-zero bitmap: wipe the words when that is cheaper
+        // than rehashing the keys that were placed
+        if (words <= placed) {
+            fill(bits.begin(), bits.begin() + words, 0);
+        } else {
+            for (size_t j = 0; j < placed; j++) {
+                uint32_t h = hashFunction(keys[j], a, b, tableSize);
+                bits[h >> 6] &= ~(1ULL << (h & 63));
+            }
+        }
+        return collisionFree;
+    }
+    
+    // Build an unpublished secondary table over a bucket's keys. Never fails:
+    // after SECONDARY_ATTEMPTS functions at size k² the table doubles for
+    // GROWTH_ROUNDS rounds of GROWTH_ATTEMPTS each, and the last function
+    // drawn then places what it can and stashes the rest. Doubling makes a
+    // collision ever less likely, but keys congruent mod p collide under
+    // every MODULO_PRIME function, so only the stash guarantees success.
+    // Returns false when the stash was needed.
+    bool buildTable(const vector<int>& keys, SecondaryTable& secTable, SplitMix64& gen,
+                    int* attemptsUsed = nullptr, PhaseTimes* times = nullptr) {
+        int k = keys.size();
+        
+        if (attemptsUsed) *attemptsUsed = 0;
+        secTable.stash.clear();
+        
+        if (k == 0) {
+            secTable.table.clear();
+            secTable.size = 0;
+            return true;
+        }
+        
+        if (k == 1) {
+            // Single element - no collision possible
+            secTable.table.resize(1);
+            secTable.table[0] = keys[0];
+            secTable.size = 1;
+            secTable.a = 1;
+            secTable.b = 0;
+            return true;
+        }
+        
+        // Try to find a collision-free hash function
+        // Secondary table size is k², then doubled while growth rounds remain
+        long long secondarySize = (long long)k * k;
+        int attempts = 0;
+        uint64_t a = 0, b = 0;
+        
+        for (int round = 0; round <= GROWTH_ROUNDS; round++) {
+            if (round > 0) {
+                if (secondarySize * 2 > INT_MAX) break;
+                secondarySize *= 2;
+            }
+            int roundAttempts = round == 0 ? SECONDARY_ATTEMPTS : GROWTH_ATTEMPTS;
+            
+            for (int t = 0; t < roundAttempts; t++) {
+                randomizeHashFunction(a, b, gen);
+                if (isCollisionFree(keys, a, b, secondarySize, times)) {
+                    // Found a collision-free hash function
+                    placeKeys(keys, secTable, a, b, secondarySize);
+                    if (attemptsUsed) *attemptsUsed = attempts;
+                    return true;
+                }
+                attempts++;
+            }
+        }
+        
+        // Every size exhausted: keep the last function and stash its collisions
+        placeKeys(keys, secTable, a, b, secondarySize);
+        if (attemptsUsed) *attemptsUsed = attempts;
+        return false;
+    }
+    
+    // Lay keys out under (a, b); a key whose slot is already taken is stashed
+    void placeKeys(const vector<int>& keys, SecondaryTable& secTable, uint64_t a, uint64_t b, int tableSize) const {
+        secTable.table.assign(tableSize, EMPTY_SLOT);
+        secTable.size = tableSize;
+        secTable.a = a;
+        secTable.b = b;
+        
+        // Place keys in secondary table
+        for (int key : keys) {
+            int h = hashFunction(key, a, b, tableSize);
+            if (secTable.table[h] == EMPTY_SLOT) secTable.table[h] = key;
+            else secTable.stash.push_back(key);
+        }
+    }
+    
+    // Scan a bucket's stash, 8 keys per compare with AVX2
+    static bool stashContains(const int* stash, uint32_t n, int key) {
+        uint32_t i = 0;
+#if defined(__AVX2__)
+        __m256i needle = _mm256_set1_epi32(key);
+        for (; i + 8 <= n; i += 8) {
+            __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(stash + i)), needle);
+            if (_mm256_movemask_epi8(eq)) return true;
+        }
+#endif
+        for (; i < n; i++) {
+            if (stash[i] == key) return true;
+        }
+        return false;
+    }
+    
+    // Rebuild the secondary table for a bucket on the side and publish it with
+    // one atomic store; readers see either the old table or the new one
+    void buildSecondaryTable(int bucketIdx, int* attemptsUsed = nullptr) {
+        Directory* dir = directory.load(memory_order_relaxed);
+        
+        unique_ptr<SecondaryTable> fresh(new SecondaryTable());
+        buildTable(buckets[bucketIdx], *fresh, rng, attemptsUsed);
+        
+        const SecondaryTable* published = fresh->size == 0 ? nullptr : fresh.release();
+        const SecondaryTable* old = dir->tables[bucketIdx].exchange(published, memory_order_seq_cst);
+        if (old) retire(old, nullptr);
+    }
+    
+    // Hand an unpublished object to epoch reclamation. Reclamation runs in
+    // batches, or right away for a whole directory, to amortize the fence.
+    void retire(const SecondaryTable* table, const Directory* dir, const PendingBuffer* buffer = nullptr) {
+        EpochDomain& domain = EpochDomain::global();
+        retired.push_back({domain.retire(), table, dir, buffer});
+        if (dir || retired.size() >= RECLAIM_BATCH) reclaim();
+    }
+    
+    // Free whatever earlier retirements no reader can still see. In
+    // incremental mode a dynamic directory's tables are left to rebuildStep.
+    void reclaim() {
+        EpochDomain& domain = EpochDomain::global();
+        domain.synchronize();
+        
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); i++) {
+            if (domain.safeToFree(retired[i].epoch)) {
+                const Directory* dir = retired[i].directory;
+                delete retired[i].table;
+                delete retired[i].buffer;
+                if (incremental && dir && dir->tables) graveyard.push_back({const_cast<Directory*>(dir), 0});
+                else delete dir;
+            } else {
+                retired[kept++] = retired[i];
+            }
+        }
+        retired.resize(kept);
+    }
+    
+    // Swap in a fully built directory and retire the previous one
+    void publish(Directory* next) {
+        Directory* old = directory.exchange(next, memory_order_seq_cst);
+        if (old) retire(nullptr, old);
+    }
+    
+    static int defaultBuildThreads() {
+        return max(1u, thread::hardware_concurrency());
+    }
+    
+    // Run body(begin, end, worker) over [0, n) split into one contiguous chunk per worker
+    static void parallelFor(int threads, size_t n, const function<void(size_t, size_t, int)>& body) {
+        if (threads <= 1 || n < 2) {
+            body(0, n, 0);
+            return;
+        }
+        
+        vector<thread> pool;
+        size_t chunk = (n + threads - 1) / threads;
+        for (int t = 0; t < threads && t * chunk < n; t++) {
+            pool.emplace_back(body, t * chunk, min(n, (t + 1) * chunk), t);
+        }
+        for (thread& worker : pool) worker.join();
+    }
+    
+    // Build every non-empty bucket's secondary table into `next`. Buckets are
+    // ordered largest first and dealt round-robin into one queue per worker;
+    // a worker that drains its own queue steals from the others, so a single
+    // giant bucket starts first and never leaves the rest of the pool idle.
+    // Each bucket draws from its own generator seeded by (buildSeed, bucket),
+    // so the result does not depend on which worker built it.
+    void buildSecondaryTables(Directory& next, int threads, uint64_t buildSeed, BuildReport& report) {
+        int primarySize = next.primarySize;
+        vector<int> order;
+        for (int i = 0; i < primarySize; i++) {
+            if (!buckets[i].empty()) order.push_back(i);
+        }
+        stable_sort(order.begin(), order.end(),
+                    [&](int x, int y) { return buckets[x].size() > buckets[y].size(); });
+        
+        threads = max(1, min<int>(threads, order.size()));
+        
+        struct alignas(64) WorkQueue {
+            vector<int> bucketIds;
+            atomic<size_t> cursor{0};  // Owner and thieves both claim from the front
+        };
+        vector<WorkQueue> queues(threads);
+        for (size_t j = 0; j < order.size(); j++) queues[j % threads].bucketIds.push_back(order[j]);
+        
+        vector<int> retries(threads, 0);
+        vector<PhaseTimes> times(threads);
+        report.bucketAttempts.assign(primarySize, 0);
+        
+        parallelFor(threads, threads, [&](size_t, size_t, int worker) {
+            for (int v = 0; v < threads; v++) {
+                WorkQueue& queue = queues[(worker + v) % threads];
+                
+                while (true) {
+                    size_t j = queue.cursor.fetch_add(1, memory_order_relaxed);
+                    if (j >= queue.bucketIds.size()) break;
+                    
+                    int i = queue.bucketIds[j];
+                    vector<int>& keys = buckets[i];
+                    sort(keys.begin(), keys.end());
+                    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+                    
+                    int attempts = 0;
+                    SplitMix64 bucketRng(buildSeed ^ ((uint64_t)i * 0xd1b54a32d192ed03ULL));
+                    unique_ptr<SecondaryTable> secTable(new SecondaryTable());
+                    buildTable(keys, *secTable, bucketRng, &attempts, profileBuild ? &times[worker] : nullptr);
+                    retries[worker] += attempts;
+                    report.bucketAttempts[i] = attempts;
+                    if (secTable->size > 0) next.tables[i].store(secTable.release(), memory_order_relaxed);
+                }
+            }
+        });
+        
+        for (int t = 0; t < threads; t++) {
+            report.secondaryRetries += retries[t];
+            report.hashingMs += times[t].hashingNs / 1e6;
+            report.collisionCheckMs += times[t].checkingNs / 1e6;
+        }
+    }
+    
+    // Redistribute `keys` over a fresh primary level of `newPrimarySize`
+    // buckets. Picks a Level 1 function whose buckets satisfy the FKS bound
+    // sum(k²) <= c·n, partitions the keys in a single pass and builds each
+    // secondary table once. Duplicates are dropped per bucket. Large key sets
+    // are hashed, partitioned and built on `buildThreads` workers.
+    void rehash(const vector<int>& keys, int newPrimarySize, BuildReport& report) {
+        cancelRebuilds();  // Every pending key is in `keys`
+        int n = keys.size();
+        int primarySize = max(1, newPrimarySize);
+        int threads = n >= PARALLEL_BUILD_MIN_KEYS ? buildThreads : 1;
+        report.threads = threads;
+        uint64_t a1, b1;
+        
+        // Level 1: retry until the expected-linear space bound holds
+        vector<int> bucketIdx(n);
+        unique_ptr<atomic<int>[]> counts(new atomic<int>[primarySize]);
+        int maxAttempts = 100;
+        
+        for (int attempt = 0; ; attempt++) {
+            randomizeHashFunction(a1, b1, rng);
+            for (int i = 0; i < primarySize; i++) counts[i].store(0, memory_order_relaxed);
+            
+            auto hashStart = chrono::steady_clock::now();
+            parallelFor(threads, n, [&](size_t begin, size_t end, int) {
+                for (size_t i = begin; i < end; i++) {
+                    bucketIdx[i] = hashFunction(keys[i], a1, b1, primarySize);
+                    if (threads > 1) counts[bucketIdx[i]].fetch_add(1, memory_order_relaxed);
+                    else counts[bucketIdx[i]].store(counts[bucketIdx[i]].load(memory_order_relaxed) + 1, memory_order_relaxed);
+                }
+            });
+            if (profileBuild) {
+                report.hashingMs += chrono::duration<double, milli>(chrono::steady_clock::now() - hashStart).count();
+            }
+            
+            sumSquares = 0;
+            for (int i = 0; i < primarySize; i++) {
+                long long c = counts[i].load(memory_order_relaxed);
+                sumSquares += c * c;
+            }
+            
+            if (sumSquares <= (long long)SUM_SQUARES_FACTOR * n || attempt + 1 >= maxAttempts) break;
+            report.primaryRetries++;
+        }
+        
+        // Partition keys into exactly sized buckets; counts become fill cursors
+        buckets.assign(primarySize, vector<int>());
+        parallelFor(threads, primarySize, [&](size_t begin, size_t end, int) {
+            for (size_t i = begin; i < end; i++) {
+                buckets[i].resize(counts[i].load(memory_order_relaxed));
+                counts[i].store(0, memory_order_relaxed);
+            }
+        });
+        parallelFor(threads, n, [&](size_t begin, size_t end, int) {
+            for (size_t i = begin; i < end; i++) {
+                int pos = counts[bucketIdx[i]].fetch_add(1, memory_order_relaxed);
+                buckets[bucketIdx[i]][pos] = keys[i];
+            }
+        });
+        
+        // Level 2: into a directory readers cannot see yet
+        unique_ptr<Directory> next(new Directory(primarySize, a1, b1, false));
+        buildSecondaryTables(*next, threads, rng.next(), report);
+        
+        // Per-bucket deduplication may have shrunk some buckets
+        totalKeys = holdsMinusOne.load(memory_order_relaxed);
+        sumSquares = 0;
+        report.bucketSizeHistogram.clear();
+        for (int i = 0; i < primarySize; i++) {
+            size_t k = buckets[i].size();
+            totalKeys += k;
+            sumSquares += (long long)k * k;
+            tallyBucket(report, i, k, next->tables[i].load(memory_order_relaxed));
+        }
+        
+        publish(next.release());
+        if (pending.load(memory_order_relaxed)) compactPending();
+    }
+    
+    // Add one built bucket of k keys to the report's histogram and slot totals
+    static void tallyBucket(BuildReport& report, int i, size_t k, const SecondaryTable* secTable) {
+        if (report.bucketSizeHistogram.size() <= k) report.bucketSizeHistogram.resize(k + 1, 0);
+        report.bucketSizeHistogram[k]++;
+        if (!secTable) return;
+        
+        report.totalSlots += secTable->size;
+        report.occupiedSlots += k - secTable->stash.size();
+        report.grownBuckets += (size_t)secTable->size > k * k;
+        if (!secTable->stash.empty()) {
+            report.stashedBuckets++;
+            report.stashedKeys += secTable->stash.size();
+            report.stashedBucketIds.push_back(i);
+        }
+    }
+    
+    // Keep the report of the latest build or global rehash and hand it to
+    // the observer, if one is registered
+    void recordReport(BuildReport report) {
+        lastReport = move(report);
+        if (buildObserver) buildObserver(lastReport);
+    }
+    
+    // Bulk build over a static key set, with the primary level sized to n
+    BuildReport build(const vector<int>& keys) {
+        auto start = chrono::steady_clock::now();
+        BuildReport report;
+        
+        bool minusOne = find(keys.begin(), keys.end(), EMPTY_SLOT) != keys.end();
+        holdsMinusOne.store(minusOne, memory_order_release);
+        if (minusOne) {
+            vector<int> placed;
+            placed.reserve(keys.size());
+            remove_copy(keys.begin(), keys.end(), back_inserter(placed), EMPTY_SLOT);
+            rehash(placed, keys.size(), report);
+        } else {
+            rehash(keys, keys.size(), report);
+        }
+        report.keys = totalKeys;
+        
+        auto end = chrono::steady_clock::now();
+        report.milliseconds = chrono::duration<double, milli>(end - start).count();
+        recordReport(report);
+        return report;
+    }
+    
+    // Report of the latest bulk build or global rehash (including rehashes
+    // triggered by insert)
+    const BuildReport& lastBuildReport() const { return lastReport; }
+    
+    // Call observer with the report after every build and global rehash,
+    // e.g. to export counters or log slow and failed buckets
+    void setBuildObserver(function<void(const BuildReport&)> observer) { buildObserver = move(observer); }
+    
+    // Time Level 1 and 2 hashing and collision checks into the reports. Adds
+    // two clock reads per Level 2 attempt, so it is off by default.
+    void setBuildProfiling(bool enabled) { profileBuild = enabled; }
+    
+    // Worker count for large rebuilds (defaults to the hardware thread count)
+    void setBuildThreads(int threads) { buildThreads = max(1, threads); }
+    
+    // Global rehash once sum(k²) passes c·n: grow the primary level to 2n so
+    // the next rehash is another n inserts away, as in dynamic perfect hashing
+    bool growAndRehash() {
+        rehashAll(max(primaryBuckets(), 2 * totalKeys));
+        return true;
+    }
+    
+    // Global rehash once n falls below a quarter of the primary level: back
+    // to 2n buckets, so the next shrink is another n/2 erases away
+    void shrinkAndRehash() {
+        rehashAll(max(1, 2 * totalKeys));
+    }
+    
+    // Redistribute the live keys over newPrimarySize buckets and report it
+    void rehashAll(int newPrimarySize) {
+        vector<int> keys;
+        keys.reserve(totalKeys);
+        for (const vector<int>& bucket : buckets) {
+            keys.insert(keys.end(), bucket.begin(), bucket.end());
+        }
+        
+        auto start = chrono::steady_clock::now();
+        BuildReport report;
+        rehash(keys, newPrimarySize, report);
+        rehashCount++;
+        report.keys = totalKeys;
+        report.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        recordReport(report);
+    }
+    
+    // Spread rebuilds over later operations, so no insert pays for a large
+    // bucket or a global rehash. An insert appends its key to the bucket list
+    // and to the pending buffer, which lookups scan after the slot, and then
+    // runs one rebuildStep. erase, freeze and growAndRehash first finish
+    // the outstanding work; turning the mode off does too.
+    //
+    // On glibc this also turns off malloc's fastbins, for the whole process.
+    // They park freed small blocks unmerged, and the next large malloc or
+    // free merges every one of them: after a rehash frees a directory of
+    // small tables, that is about 100 ms on one insert, however the frees
+    // were spread out.
+    void setIncrementalRebuild(bool enabled) {
+        if (!enabled) finishRebuilds();
+#ifdef __GLIBC__
+        if (enabled) mallopt(M_MXFAST, 0);
+#endif
+        incremental = enabled;
+        if (enabled && !pending.load(memory_order_relaxed)) pending.store(new PendingBuffer(), memory_order_seq_cst);
+    }
+    
+    bool incrementalRebuild() const { return incremental; }
+    
+    // Inserted keys still waiting for their secondary table
+    int pendingKeys() const {
+        const PendingBuffer* buffer = pending.load(memory_order_acquire);
+        return buffer ? buffer->count.load(memory_order_acquire) : 0;
+    }
+    
+    // Is a global rehash running in the background?
+    bool rehashInProgress() const { return job != nullptr; }
+    
+    /*
+        One bounded slice of outstanding work, in order: rebuild dirty
+        buckets until REBUILD_STEP_UNITS slots are written, advance a running
+        global rehash by REBUILD_STEP_UNITS keys, free FREE_STEP_BYTES of
+        retired tables and stale key lists (each free touches cold memory).
+        A single bucket rebuild is never split, so a step costs
+        O(REBUILD_STEP_UNITS + k²) for the largest bucket k.
+        Returns true while work remains; call it from idle time to finish early.
+    */
+    bool rebuildStep() {
+        rebuildDirty();
+        
+        if (job) advanceRehash(REBUILD_STEP_UNITS);
+        
+        size_t freed = 0;
+        while (!graveyard.empty() && freed < FREE_STEP_BYTES) {
+            Grave& grave = graveyard.back();
+            for (; grave.cursor < grave.dir->primarySize && freed < FREE_STEP_BYTES; grave.cursor++) {
+                const SecondaryTable* table = grave.dir->tables[grave.cursor].exchange(nullptr, memory_order_relaxed);
+                freed += sizeof(table);
+                if (!table) continue;
+                freed += sizeof(SecondaryTable) + (table->table.capacity() + table->stash.capacity()) * sizeof(int);
+                delete table;
+            }
+            if (grave.cursor == grave.dir->primarySize) {
+                grave.dir->tables.reset();  // Every entry is null by now
+                delete grave.dir;
+                graveyard.pop_back();
+            }
+        }
+        for (; !staleBuckets.empty() && freed < FREE_STEP_BYTES; staleBuckets.pop_back()) {
+            freed += sizeof(vector<int>) + staleBuckets.back().capacity() * sizeof(int);
+        }
+        if (staleBuckets.empty() && staleBuckets.capacity()) vector<vector<int>>().swap(staleBuckets);
+        
+        // Drop placed keys from the buffer once half of it is used; replacing
+        // it on every insert would retire a buffer per insert
+        if (2 * pendingKeys() >= PendingBuffer::CAPACITY) compactPending();
+        
+        return !dirtyBuckets.empty() || job || !graveyard.empty() || !staleBuckets.empty();
+    }
+    
+    // Rebuild dirty buckets, oldest first, until REBUILD_STEP_UNITS slots are
+    // written; at least one bucket when any is dirty
+    void rebuildDirty() {
+        long long units = 0;
+        while (!dirtyBuckets.empty() && units < REBUILD_STEP_UNITS) {
+            int bucketIdx = dirtyBuckets.front();
+            dirtyBuckets.pop_front();
+            long long k = buckets[bucketIdx].size();
+            units += max(1LL, k * k);
+            buildSecondaryTable(bucketIdx);
+        }
+    }
+    
+    // Run rebuildStep until nothing is outstanding and the buffer is empty
+    void finishRebuilds() {
+        while (rebuildStep()) {}
+        if (pendingKeys() > 0) compactPending();
+    }
+    
+    // Abandon incremental work that a full rehash of `buckets` supersedes
+    void cancelRebuilds() {
+        job.reset();
+        dirtyBuckets.clear();
+    }
+    
+    // Replace the pending buffer with one holding only the keys whose bucket
+    // still waits for its rebuild. Those tables were published first, so a
+    // reader that sees the new buffer also sees the tables.
+    void compactPending() {
+        const Directory* dir = directory.load(memory_order_relaxed);
+        PendingBuffer* fresh = new PendingBuffer();
+        vector<int> dirty(dirtyBuckets.begin(), dirtyBuckets.end());
+        sort(dirty.begin(), dirty.end());
+        
+        PendingBuffer* old = pending.load(memory_order_relaxed);
+        int kept = 0;
+        for (int i = 0, n = old->count.load(memory_order_relaxed); i < n; i++) {
+            int bucketIdx = hashFunction(old->keys[i], dir->a1, dir->b1, dir->primarySize);
+            if (binary_search(dirty.begin(), dirty.end(), bucketIdx)) fresh->keys[kept++] = old->keys[i];
+        }
+        fresh->count.store(kept, memory_order_relaxed);
+        
+        pending.store(fresh, memory_order_seq_cst);
+        retire(nullptr, nullptr, old);
+    }
+    
+    // Publish key in the pending buffer. If inserts outran the steps and the
+    // buffer is full of unplaced keys, one step's worth of dirty buckets is
+    // built right away; their keys leave the buffer, which makes room.
+    void appendPending(int key) {
+        PendingBuffer* buffer = pending.load(memory_order_relaxed);
+        int n = buffer->count.load(memory_order_relaxed);
+        if (n == PendingBuffer::CAPACITY) {
+            rebuildDirty();
+            compactPending();
+            buffer = pending.load(memory_order_relaxed);
+            n = buffer->count.load(memory_order_relaxed);
+        }
+        buffer->keys[n] = key;
+        buffer->count.store(n + 1, memory_order_release);
+    }
+    
+    // Queue a bucket for rebuildStep; the queue holds each bucket once
+    void markDirty(int bucketIdx) {
+        if (find(dirtyBuckets.begin(), dirtyBuckets.end(), bucketIdx) == dirtyBuckets.end()) {
+            dirtyBuckets.push_back(bucketIdx);
+        }
+    }
+    
+    // Begin a global rehash onto newPrimarySize buckets that rebuildStep
+    // carries out. Each phase reserves the array it fills in its first
+    // slice, and pages fault in a slice at a time as the phase writes them.
+    void startRehash(int newPrimarySize) {
+        job.reset(new RehashJob());
+        job->primarySize = max(1, newPrimarySize);
+        job->start = chrono::steady_clock::now();
+    }
+    
+    // Advance the running rehash by about `units` keys, buckets or slots
+    void advanceRehash(long long units) {
+        RehashJob& r = *job;
+        int primarySize = r.primarySize;
+        
+        while (units > 0) {
+            switch (r.phase) {
+            case RehashJob::COLLECTING: {
+                // Copy the old key lists bucket by bucket
+                if (r.cursor == buckets.size()) {
+                    r.bucketOf.reserve(r.keys.size());
+                    randomizeHashFunction(r.a1, r.b1, rng);
+                    r.phase = RehashJob::CLEARING;
+                    r.cursor = 0;
+                    break;
+                }
+                if (r.cursor == 0) r.keys.reserve(totalKeys);
+                const vector<int>& bucket = buckets[r.cursor++];
+                r.keys.insert(r.keys.end(), bucket.begin(), bucket.end());
+                units -= 1 + bucket.size();
+                break;
+            }
+            case RehashJob::CLEARING: {
+                // Zero the bucket counts before counting a Level 1 candidate
+                if (r.counts.capacity() == 0) r.counts.reserve(primarySize);
+                size_t end = min<size_t>(primarySize, r.cursor + units);
+                if (r.counts.size() < end) r.counts.resize(end);
+                fill(r.counts.begin() + r.cursor, r.counts.begin() + end, 0);
+                units -= max<size_t>(1, end - r.cursor);
+                r.cursor = end;
+                if (r.cursor == (size_t)primarySize) {
+                    r.phase = RehashJob::COUNTING;
+                    r.cursor = 0;
+                    r.sumSquares = 0;
+                }
+                break;
+            }
+            case RehashJob::COUNTING: {
+                // Level 1: retry until the expected-linear space bound holds
+                size_t end = min<size_t>(r.keys.size(), r.cursor + units);
+                if (r.bucketOf.size() < end) r.bucketOf.resize(end);
+                for (size_t i = r.cursor; i < end; i++) {
+                    uint32_t bucketIdx = hashFunction(r.keys[i], r.a1, r.b1, primarySize);
+                    r.bucketOf[i] = bucketIdx;
+                    r.sumSquares += 2LL * r.counts[bucketIdx]++ + 1;
+                }
+                units -= max<size_t>(1, end - r.cursor);
+                r.cursor = end;
+                if (r.cursor < r.keys.size()) break;
+                
+                r.cursor = 0;
+                if (r.sumSquares > (long long)SUM_SQUARES_FACTOR * (long long)r.keys.size() && r.attempt + 1 < 100) {
+                    r.attempt++;
+                    r.report.primaryRetries++;
+                    randomizeHashFunction(r.a1, r.b1, rng);
+                    r.phase = RehashJob::CLEARING;
+                } else {
+                    r.phase = RehashJob::SIZING;
+                }
+                break;
+            }
+            case RehashJob::SIZING: {
+                // Exactly sized key lists, and the new directory's table
+                // pointers cleared a slice at a time
+                if (!r.next) {
+                    r.next.reset(new Directory(primarySize, r.a1, r.b1, false, false));
+                    r.buckets.reserve(primarySize);
+                }
+                size_t end = min<size_t>(primarySize, r.cursor + units);
+                for (size_t i = r.cursor; i < end; i++) {
+                    r.buckets.emplace_back();
+                    r.buckets.back().reserve(r.counts[i]);
+                    r.next->tables[i].store(nullptr, memory_order_relaxed);
+                }
+                units -= max<size_t>(1, end - r.cursor);
+                r.cursor = end;
+                if (r.cursor == (size_t)primarySize) {
+                    r.phase = RehashJob::PARTITIONING;
+                    r.cursor = 0;
+                }
+                break;
+            }
+            case RehashJob::PARTITIONING: {
+                size_t end = min<size_t>(r.keys.size(), r.cursor + units);
+                for (size_t i = r.cursor; i < end; i++) r.buckets[r.bucketOf[i]].push_back(r.keys[i]);
+                units -= max<size_t>(1, end - r.cursor);
+                r.cursor = end;
+                if (r.cursor < r.keys.size()) break;
+                
+                vector<int>().swap(r.keys);
+                vector<uint32_t>().swap(r.bucketOf);
+                vector<int>().swap(r.counts);
+                r.buildSeed = rng.next();
+                r.report.bucketAttempts.reserve(primarySize);
+                r.sumSquares = 0;
+                r.phase = RehashJob::BUILDING;
+                r.cursor = 0;
+                break;
+            }
+            case RehashJob::BUILDING: {
+                // Level 2, one bucket at a time, seeded as in buildSecondaryTables
+                int i = r.cursor++;
+                vector<int>& keys = r.buckets[i];
+                sort(keys.begin(), keys.end());
+                keys.erase(unique(keys.begin(), keys.end()), keys.end());
+                
+                int attempts = 0;
+                if (!keys.empty()) {
+                    SplitMix64 bucketRng(r.buildSeed ^ ((uint64_t)i * 0xd1b54a32d192ed03ULL));
+                    SecondaryTable* secTable = new SecondaryTable();
+                    buildTable(keys, *secTable, bucketRng, &attempts);
+                    r.next->tables[i].store(secTable, memory_order_relaxed);
+                }
+                size_t k = keys.size();
+                r.report.bucketAttempts.push_back(attempts);
+                r.report.secondaryRetries += attempts;
+                tallyBucket(r.report, i, k, r.next->tables[i].load(memory_order_relaxed));
+                r.placedKeys += k;
+                r.sumSquares += (long long)k * k;
+                units -= 1 + (long long)k * k;
+                
+                if (r.cursor == (size_t)primarySize) {
+                    r.phase = RehashJob::REPLAYING;
+                    r.cursor = 0;
+                }
+                break;
+            }
+            case RehashJob::REPLAYING: {
+                // Keys inserted since COLLECTING began; some were copied already
+                if (r.cursor == r.log.size()) {
+                    finishRehash();
+                    return;
+                }
+                int key = r.log[r.cursor++];
+                int bucketIdx = hashFunction(key, r.a1, r.b1, primarySize);
+                vector<int>& keys = r.buckets[bucketIdx];
+                units--;
+                if (find(keys.begin(), keys.end(), key) != keys.end()) break;
+                
+                long long k = keys.size();
+                keys.push_back(key);
+                r.placedKeys++;
+                r.sumSquares += 2 * k + 1;
+                SecondaryTable* secTable = new SecondaryTable();
+                buildTable(keys, *secTable, rng);
+                delete r.next->tables[bucketIdx].exchange(secTable, memory_order_relaxed);
+                units -= (k + 1) * (k + 1) + REPLAY_ALLOC_UNITS;
+                break;
+            }
+            }
+        }
+    }
+    
+    // Swap the rebuilt level in. The old key lists and dirty queue are
+    // obsolete: every key they held is in the new directory.
+    void finishRehash() {
+        RehashJob& r = *job;
+        staleBuckets.clear();
+        staleBuckets.swap(buckets);
+        buckets.swap(r.buckets);
+        totalKeys = r.placedKeys + holdsMinusOne.load(memory_order_relaxed);
+        sumSquares = r.sumSquares;
+        dirtyBuckets.clear();
+        publish(r.next.release());
+        compactPending();
+        
+        rehashCount++;
+        BuildReport report = move(r.report);
+        report.keys = totalKeys;
+        report.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - r.start).count();
+        job.reset();
+        recordReport(move(report));
+    }
+    
+    // Insert key into the perfect hash table
+    bool insert(int key) {
+        if (search(key)) return true;  // A duplicate would make every level 2 function collide
+        if (bucketsDropped) return false;  // Read-only: the key lists are gone
+        if (key == EMPTY_SLOT) {
+            holdsMinusOne.store(true, memory_order_release);
+            totalKeys++;
+            return true;
+        }
+        if (isFrozen()) thaw();
+        
+        // Level 1: Insert into appropriate bucket
+        const Directory* dir = directory.load(memory_order_relaxed);
+        int bucketIdx = hashFunction(key, dir->a1, dir->b1, dir->primarySize);
+        long long k = buckets[bucketIdx].size();
+        buckets[bucketIdx].push_back(key);
+        totalKeys++;
+        sumSquares += 2 * k + 1;  // (k+1)² - k²
+        
+        if (incremental) {
+            if (job) job->log.push_back(key);
+            appendPending(key);
+            markDirty(bucketIdx);
+            if (!job && sumSquares > (long long)SUM_SQUARES_FACTOR * totalKeys) {
+                startRehash(max(primaryBuckets(), 2 * totalKeys));
+            }
+            rebuildStep();
+            return true;
+        }
+        
+        // Too many slots for the key count: pick a new Level 1 function
+        if (sumSquares > (long long)SUM_SQUARES_FACTOR * totalKeys) return growAndRehash();
+        
+        // Level 2: Rebuild secondary table for this bucket
+        buildSecondaryTable(bucketIdx);
+        return true;
+    }
+    
+    // Remove key from the table. The key leaves its bucket list and its slot
+    // (or stash entry) is cleared in place with one word store, so readers see
+    // it either present or absent; expected O(1). A secondary table whose
+    // live count falls below sqrt(size)/2 is rebuilt at live² slots, and the
+    // primary level shrinks with the key count (see shrinkAndRehash).
+    bool erase(int key) {
+        if (bucketsDropped) return false;  // Read-only: the key lists are gone
+        if (key == EMPTY_SLOT) {
+            if (!holdsMinusOne.load(memory_order_relaxed)) return false;
+            holdsMinusOne.store(false, memory_order_release);
+            totalKeys--;
+            return true;
+        }
+        finishRebuilds();
+        
+        const Directory* dir = directory.load(memory_order_relaxed);
+        int bucketIdx = hashFunction(key, dir->a1, dir->b1, dir->primarySize);
+        vector<int>& bucket = buckets[bucketIdx];
+        auto it = find(bucket.begin(), bucket.end(), key);
+        if (it == bucket.end()) return false;
+        
+        if (isFrozen()) thaw();
+        dir = directory.load(memory_order_relaxed);
+        
+        long long k = bucket.size();
+        *it = bucket.back();
+        bucket.pop_back();
+        totalKeys--;
+        sumSquares -= 2 * k - 1;  // k² - (k-1)²
+        
+        // The writer owns every published table; readers only load from it
+        SecondaryTable* secTable = const_cast<SecondaryTable*>(dir->tables[bucketIdx].load(memory_order_relaxed));
+        int h = hashFunction(key, secTable->a, secTable->b, secTable->size);
+        int* slot = secTable->table[h] == key ? &secTable->table[h]
+                  : &*find(secTable->stash.begin(), secTable->stash.end(), key);
+        __atomic_store_n(slot, EMPTY_SLOT, __ATOMIC_RELEASE);
+        
+        if (dir->primarySize > 1 && (long long)PRIMARY_SHRINK_FACTOR * totalKeys < dir->primarySize) {
+            shrinkAndRehash();
+        } else if ((long long)SECONDARY_SHRINK_FACTOR * (k - 1) * (k - 1) < secTable->size) {
+            buildSecondaryTable(bucketIdx);
+        }
+        return true;
+    }
+    
+    // Freeze into one region of 2 MB pages instead of heap vectors, so a large
+    // table's random lookups stay within the TLB's reach. Small tables are
+    // packed to never straddle a cache line. Takes effect at the next freeze.
+    void setHugePageLayout(bool enabled) { hugePageLayout = enabled; }
+    
+    // Keep one copy of the frozen layout per NUMA node and serve each lookup
+    // from the caller's node, so remote sockets don't pay cross-socket
+    // latency per probe. Costs a copy per node; a no-op on one-node systems.
+    // Takes effect at the next freeze or loadMapped.
+    void setNumaReplication(bool enabled) { numaReplication = enabled; }
+    
+private:
+    static const uint32_t LINE_SLOTS = 64 / sizeof(int);
+    
+    // Assign slot offsets so that no block of up to a line straddles a cache
+    // line: blocks over a line go first, each starting on a line; the rest
+    // are placed largest first into the fullest line with room (best fit).
+    // Returns the slot count, padding included.
+    static size_t packBlocks(vector<BucketHeader>& headers, const vector<uint32_t>& blockSize) {
+        vector<int> order;
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (blockSize[i] > 0) order.push_back(i);
+        }
+        stable_sort(order.begin(), order.end(), [&](int x, int y) { return blockSize[x] > blockSize[y]; });
+        
+        size_t end = 0;
+        vector<vector<size_t>> openLines(LINE_SLOTS);  // [r] = next free slot of lines with r slots left
+        for (int i : order) {
+            uint32_t need = blockSize[i];
+            if (need > LINE_SLOTS) {
+                headers[i].offset = end;
+                end += (need + LINE_SLOTS - 1) / LINE_SLOTS * LINE_SLOTS;
+                continue;
+            }
+            uint32_t room = need;
+            while (room < LINE_SLOTS && openLines[room].empty()) room++;
+            size_t at;
+            if (room < LINE_SLOTS) {
+                at = openLines[room].back();
+                openLines[room].pop_back();
+            } else {
+                at = end;
+                end += LINE_SLOTS;
+            }
+            headers[i].offset = at;
+            if (room > need) openLines[room - need].push_back(at + need);
+        }
+        return end;
+    }
+    
+    // Copy the frozen layout of source into an anonymous region owned by
+    // target, slots starting on a cache line. With hugePages the region is
+    // aligned to 2 MB and backed by explicit huge pages when the system has
+    // some reserved (vm.nr_hugepages), else by transparent huge pages on
+    // request. Returns false, leaving target as it was, if nothing can be mapped.
+    static bool copyLayout(const Directory& source, Directory& target, bool hugePages) {
+#if defined(__unix__) || defined(__APPLE__)
+        const size_t HUGE_PAGE = size_t(2) << 20;
+        size_t headerBytes = (size_t)source.primarySize * sizeof(BucketHeader);
+        size_t slotStart = (headerBytes + 63) / 64 * 64;
+        size_t length = slotStart + source.slotCount * sizeof(int);
+        
+        shared_ptr<const void> region;
+        if (!hugePages) {
+            void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base == MAP_FAILED) return false;
+            region.reset(base, [length](const void* p) { munmap((void*)p, length); });
+        }
+        
+        length = (length + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+#ifdef MAP_HUGETLB
+        if (!region) {
+            void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base != MAP_FAILED) region.reset(base, [length](const void* p) { munmap((void*)p, length); });
+        }
+#endif
+        if (!region) {
+            // Over-map by one huge page so the region can start on a 2 MB boundary
+            size_t padded = length + HUGE_PAGE;
+            void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) return false;
+            void* aligned = (void*)(((uintptr_t)raw + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1));
+#ifdef MADV_HUGEPAGE
+            madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+            region.reset(aligned, [raw, padded](const void*) { munmap(raw, padded); });
+        }
+        
+        char* bytes = (char*)region.get();
+        memcpy(bytes, source.headers, headerBytes);
+        memcpy(bytes + slotStart, source.slots, source.slotCount * sizeof(int));
+        target.headers = (const BucketHeader*)bytes;
+        target.slots = (const int*)(bytes + slotStart);
+        target.slotCount = source.slotCount;
+        target.mapping = region;
+        target.hugePages = hugePages;
+        return true;
+#else
+        (void)source; (void)target; (void)hugePages;
+        return false;
+#endif
+    }
+    
+    // Move a frozen directory out of its vectors into a huge page region;
+    // keeps the vectors if no region can be mapped
+    static void moveToHugePages(Directory& dir) {
+        if (!copyLayout(dir, dir, true)) return;
+        vector<BucketHeader>().swap(dir.headerStore);
+        vector<int>().swap(dir.slotStore);
+    }
+    
+    // CPUs of each NUMA node, indexed by node id and empty for absent ids.
+    // Read once from sysfs; a single entry where there is no node topology.
+    static const vector<vector<int>>& numaNodes() {
+        static const vector<vector<int>> nodes = readNumaNodes();
+        return nodes;
+    }
+    
+    static vector<vector<int>> readNumaNodes() {
+        vector<vector<int>> nodes;
+#ifdef __linux__
+        for (int node = 0; node < MAX_NUMA_NODES; node++) {
+            ifstream in("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+            if (!in) continue;
+            nodes.resize(node + 1);
+            string range;  // "3" or "0-7"
+            while (getline(in, range, ',')) {
+                int first = 0, last = 0;
+                int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+                if (fields < 1) continue;
+                if (fields == 1) last = first;
+                for (int cpu = first; cpu <= last; cpu++) nodes[node].push_back(cpu);
+            }
+        }
+#endif
+        if (nodes.empty()) nodes.resize(1);
+        return nodes;
+    }
+    
+    // NUMA node of the calling thread, re-read every NODE_REFRESH_CALLS
+    // calls in case the scheduler moved it
+    static int currentNode() {
+        thread_local int node = -1;
+        thread_local unsigned calls = 0;
+        if (node < 0 || ++calls % NODE_REFRESH_CALLS == 0) {
+            node = 0;
+#if defined(__linux__) && defined(SYS_getcpu)
+            unsigned cpu = 0, cpuNode = 0;
+            if (syscall(SYS_getcpu, &cpu, &cpuNode, nullptr) == 0) node = cpuNode;
+#endif
+        }
+        return node;
+    }
+    
+    // The copy of a frozen directory on the caller's node, or dir itself
+    static const Directory& localReplica(const Directory& dir) {
+        if (dir.replicas.empty()) return dir;
+        size_t node = currentNode();
+        const Directory* replica = node < dir.replicas.size() ? dir.replicas[node].get() : nullptr;
+        return replica ? *replica : dir;
+    }
+    
+    // Give every NUMA node its own copy of a frozen directory. Each copy is
+    // made by a thread pinned to the node, so first touch places its pages
+    // there. Nodes whose copy can't be mapped keep using dir itself.
+    void buildReplicas(Directory& dir) const {
+#ifdef __linux__
+        const vector<vector<int>>& nodes = numaNodes();
+        if (count_if(nodes.begin(), nodes.end(), [](const vector<int>& cpus) { return !cpus.empty(); }) < 2) return;
+        
+        dir.replicas.resize(nodes.size());
+        vector<thread> workers;
+        for (size_t node = 0; node < nodes.size(); node++) {
+            if (nodes[node].empty()) continue;
+            workers.emplace_back([&, node] {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                for (int cpu : nodes[node]) {
+                    if (cpu < CPU_SETSIZE) CPU_SET(cpu, &cpus);
+                }
+                sched_setaffinity(0, sizeof(cpus), &cpus);
+                unique_ptr<Directory> replica(new Directory(dir.primarySize, dir.a1, dir.b1, true));
+                if (copyLayout(dir, *replica, hugePageLayout)) dir.replicas[node] = move(replica);
+            });
+        }
+        for (thread& worker : workers) worker.join();
+#else
+        (void)dir;
+#endif
+    }
+    
+public:
+    // Pack every secondary table into one contiguous slot array with a header
+    // per bucket. With dropBuckets the per-bucket key lists are released too,
+    // leaving a read-only table that rejects further inserts.
+    void freeze(bool dropBuckets = false) {
+        finishRebuilds();
+        const Directory* dir = directory.load(memory_order_relaxed);
+        
+        if (!dir->frozen) {
+            int primarySize = dir->primarySize;
+            unique_ptr<Directory> next(new Directory(primarySize, dir->a1, dir->b1, true));
+            vector<BucketHeader>& headerStore = next->headerStore;
+            vector<int>& slotStore = next->slotStore;
+            headerStore.assign(primarySize, BucketHeader());
+            
+            // Headers first; a bucket's block of slots is its table followed
+            // by its live stash, and one-slot tables live in the header
+            vector<uint32_t> blockSize(primarySize, 0);
+            for (int i = 0; i < primarySize; i++) {
+                const SecondaryTable* secTable = dir->tables[i].load(memory_order_relaxed);
+                BucketHeader& header = headerStore[i];
+                header.size = secTable ? secTable->size : 0;
+                header.a = secTable ? secTable->a : 0;
+                header.b = secTable ? secTable->b : 0;
+                header.inlineKey = EMPTY_SLOT;
+                if (!secTable) continue;
+                for (int key : secTable->stash) header.stashSize += key != EMPTY_SLOT;  // Cleared by erase
+                // A one-key bucket never collides, so a one-slot table has no stash
+                if (header.size == 1) header.inlineKey = secTable->table[0];
+                else blockSize[i] = header.size + header.stashSize;
+            }
+            
+            size_t total = hugePageLayout ? packBlocks(headerStore, blockSize) : 0;
+            if (!hugePageLayout) {
+                for (int i = 0; i < primarySize; i++) {
+                    headerStore[i].offset = total;
+                    total += blockSize[i];
+                }
+            }
+            
+            slotStore.assign(total, EMPTY_SLOT);
+            for (int i = 0; i < primarySize; i++) {
+                if (blockSize[i] == 0) continue;
+                const SecondaryTable* secTable = dir->tables[i].load(memory_order_relaxed);
+                int* block = slotStore.data() + headerStore[i].offset;
+                block = copy(secTable->table.begin(), secTable->table.end(), block);
+                copy_if(secTable->stash.begin(), secTable->stash.end(), block, [](int key) { return key != EMPTY_SLOT; });
+            }
+            
+            next->headers = headerStore.data();
+            next->slots = slotStore.data();
+            next->slotCount = slotStore.size();
+            if (hugePageLayout) moveToHugePages(*next);
+            if (numaReplication) buildReplicas(*next);
+            publish(next.release());
+        }
+        
+        if (dropBuckets && !bucketsDropped) {
+            vector<vector<int>>().swap(buckets);
+            bucketsDropped = true;
+        }
+    }
+    
+    bool isFrozen() const { return directory.load(memory_order_acquire)->frozen; }
+    
+    int primaryBuckets() const { return directory.load(memory_order_acquire)->primarySize; }
+    
+    // Unpack the frozen layout back into per-bucket tables so it can be mutated
+    void thaw() {
+        const Directory* dir = directory.load(memory_order_relaxed);
+        unique_ptr<Directory> next(new Directory(dir->primarySize, dir->a1, dir->b1, false));
+        
+        for (int i = 0; i < dir->primarySize; i++) {
+            const BucketHeader& header = dir->headers[i];
+            if (header.size == 0) continue;
+            
+            SecondaryTable* secTable = new SecondaryTable();
+            const int* first = header.size == 1 ? &header.inlineKey : dir->slots + header.offset;
+            secTable->table.assign(first, first + header.size);
+            secTable->stash.assign(first + header.size, first + header.size + header.stashSize);
+            secTable->size = header.size;
+            secTable->a = header.a;
+            secTable->b = header.b;
+            next->tables[i].store(secTable, memory_order_relaxed);
+        }
+        
+        publish(next.release());
+    }
+    
+    /*
+        On-disk format (version 4), native byte order:
+        
+            FileHeader                      64 bytes
+            BucketHeader[primarySize]       32 bytes each: a, b, offset,
+                                            size, stashSize, inlineKey
+            int[slotCount]                  the flat slot array
+        
+        Both arrays are stored exactly as the frozen layout holds them, so a
+        load maps the file and points the directory into it: no copy and no
+        parsing. The checksum covers everything after the file header.
+        Version 2 added stashSize in what was header padding; version 1
+        files have it zeroed and still load. Version 3 moved one-slot
+        tables into inlineKey (the last padding word); older files keep
+        them in the slot array and have their headers copied and inlined
+        on load. Version 4 took the high half of bucketHeaderSize for
+        flags (FILE_HOLDS_MINUS_ONE); older files there hold zero on
+        little-endian machines and are read with no flags.
+    */
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t family;
+        uint16_t bucketHeaderSize;  // Guards against a layout change
+        uint16_t flags;             // Version 4 on
+        uint32_t primarySize;
+        uint64_t a1, b1;
+        uint64_t slotCount;
+        uint64_t keyCount;
+        uint64_t checksum;
+    };
+    static_assert(sizeof(FileHeader) == 64, "file header is one cache line");
+    
+    static constexpr char FILE_MAGIC[8] = {'F', 'K', 'S', 'P', 'H', 'T', '\0', '\0'};
+    static const uint32_t FILE_VERSION = 4;  // 4: flags
+    static const uint16_t FILE_HOLDS_MINUS_ONE = 1;  // The table holds key -1 (see EMPTY_SLOT)
+    
+    // 64-bit multiply-rotate checksum over whole words plus a byte tail
+    static uint64_t checksum(const void* data, size_t length, uint64_t h = 0x243f6a8885a308d3ULL) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        size_t words = length / 8;
+        for (size_t i = 0; i < words; i++) {
+            uint64_t w;
+            memcpy(&w, bytes + i * 8, 8);
+            h = ((h ^ w) * 0x9e3779b97f4a7c15ULL);
+            h ^= h >> 29;
+        }
+        for (size_t i = words * 8; i < length; i++) h = (h ^ bytes[i]) * 0x100000001b3ULL;
+        return h ^ length;
+    }
+    
+    // Write a frozen table to `path`; fails if the table is not frozen
+    bool save(const string& path) const {
+        const Directory* dir = directory.load(memory_order_acquire);
+        if (!dir->frozen) return false;
+        
+        size_t headerBytes = (size_t)dir->primarySize * sizeof(BucketHeader);
+        size_t slotBytes = dir->slotCount * sizeof(int);
+        
+        FileHeader fileHeader;
+        memset(&fileHeader, 0, sizeof(fileHeader));
+        memcpy(fileHeader.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        fileHeader.version = FILE_VERSION;
+        fileHeader.family = family;
+        fileHeader.bucketHeaderSize = sizeof(BucketHeader);
+        fileHeader.flags = holdsMinusOne.load(memory_order_relaxed) ? FILE_HOLDS_MINUS_ONE : 0;
+        fileHeader.primarySize = dir->primarySize;
+        fileHeader.a1 = dir->a1;
+        fileHeader.b1 = dir->b1;
+        fileHeader.slotCount = dir->slotCount;
+        fileHeader.keyCount = totalKeys;
+        fileHeader.checksum = checksum(dir->slots, slotBytes, checksum(dir->headers, headerBytes));
+        
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write((const char*)&fileHeader, sizeof(fileHeader));
+        out.write((const char*)dir->headers, headerBytes);
+        out.write((const char*)dir->slots, slotBytes);
+        return (bool)out;
+    }
+    
+    // Replace this table with a read-only view of a file written by save().
+    // The file is mapped, not read: pages load on first touch and are shared
+    // through the page cache by every process mapping the same file. With
+    // verify the checksum and every bucket's bounds are checked first, which
+    // reads the whole file once; skip it only for trusted files. Call before
+    // handing the table to reader threads, since it may change the family.
+    bool loadMapped(const string& path, bool verify = true) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(FileHeader)) {
+            close(fd);
+            return false;
+        }
+        
+        size_t length = info.st_size;
+        void* base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return false;
+        shared_ptr<const void> mapping(base, [length](const void* p) { munmap((void*)p, length); });
+        
+        const FileHeader& fileHeader = *(const FileHeader*)base;
+        size_t headerBytes = (size_t)fileHeader.primarySize * sizeof(BucketHeader);
+        size_t payloadBytes = length - sizeof(FileHeader);
+        if (memcmp(fileHeader.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+            fileHeader.version == 0 || fileHeader.version > FILE_VERSION ||
+            fileHeader.bucketHeaderSize != sizeof(BucketHeader) ||
+            fileHeader.family > MULTIPLY_SHIFT ||
+            fileHeader.primarySize == 0 ||
+            headerBytes > payloadBytes) {
+            return false;
+        }
+        // Bound slotCount by the file before multiplying, so a corrupt count
+        // can't wrap around to match the length
+        if (fileHeader.slotCount > (payloadBytes - headerBytes) / sizeof(int)) return false;
+        size_t slotCount = fileHeader.slotCount;
+        size_t slotBytes = slotCount * sizeof(int);
+        if (headerBytes + slotBytes != payloadBytes) return false;
+        
+        const char* payload = (const char*)base + sizeof(FileHeader);
+        const BucketHeader* headers = (const BucketHeader*)payload;
+        const int* slots = (const int*)(payload + headerBytes);
+        
+        if (verify) {
+            uint64_t sum = checksum(slots, slotBytes, checksum(headers, headerBytes));
+            if (sum != fileHeader.checksum) return false;
+            for (uint32_t i = 0; i < fileHeader.primarySize; i++) {
+                const BucketHeader& header = headers[i];
+                bool inlined = fileHeader.version >= 3 && header.size <= 1;
+                if (inlined && header.stashSize != 0) return false;
+                if (!inlined && (uint64_t)header.offset + header.size + header.stashSize > slotCount) return false;
+            }
+        }
+        
+        unique_ptr<Directory> next(new Directory(fileHeader.primarySize, fileHeader.a1, fileHeader.b1, true));
+        if (fileHeader.version < 3) {
+            // Older files keep one-slot tables in the slot array: copy the
+            // headers out of the mapping and inline those slots
+            next->headerStore.assign(headers, headers + fileHeader.primarySize);
+            for (BucketHeader& header : next->headerStore) {
+                header.inlineKey = header.size == 1 ? slots[header.offset] : EMPTY_SLOT;
+            }
+            headers = next->headerStore.data();
+        }
+        next->headers = headers;
+        next->slots = slots;
+        next->slotCount = slotCount;
+        next->mapping = mapping;
+        if (numaReplication) buildReplicas(*next);
+        
+        family = (HashFamily)fileHeader.family;
+        vector<vector<int>>().swap(buckets);
+        bucketsDropped = true;
+        totalKeys = fileHeader.keyCount;
+        holdsMinusOne.store(fileHeader.version >= 4 && (fileHeader.flags & FILE_HOLDS_MINUS_ONE), memory_order_release);
+        // slotCount also holds stashes and padding, and misses inlined
+        // buckets: sum the table sizes instead (an inlined bucket has size 1)
+        sumSquares = 0;
+        for (uint32_t i = 0; i < fileHeader.primarySize; i++) sumSquares += headers[i].size;
+        rehashCount = 0;
+        cancelRebuilds();
+        publish(next.release());
+        if (pending.load(memory_order_relaxed)) compactPending();
+        return true;
+#else
+        (void)path; (void)verify;
+        return false;
+#endif
+    }
+    
+    // Search for a key in the perfect hash table. Safe to call from any number
+    // of threads while one writer inserts, rebuilds or freezes.
+    bool search(int key) const {
+        EpochDomain::ReadGuard guard;
+        // Pending first: a key leaves the buffer only after its table is published
+        const PendingBuffer* buffer = pending.load(memory_order_seq_cst);
+        return searchIn(localReplica(*directory.load(memory_order_seq_cst)), key) || pendingContains(buffer, key);
+    }
+    
+    static bool pendingContains(const PendingBuffer* buffer, int key) {
+        if (!buffer) return false;
+        uint32_t n = buffer->count.load(memory_order_acquire);
+        return n && stashContains(buffer->keys, n, key);
+    }
+    
+    bool searchIn(const Directory& dir, int key) const {
+        // An EMPTY_SLOT probe would match every cleared slot
+        if (key == EMPTY_SLOT) return holdsMinusOne.load(memory_order_acquire);
+        
+        // Level 1: Find the bucket
+        int bucketIdx = hashFunction(key, dir.a1, dir.b1, dir.primarySize);
+        
+        if (dir.frozen) {
+            const BucketHeader& header = dir.headers[bucketIdx];
+            if (header.size <= 1) return header.size == 1 && header.inlineKey == key;
+            
+            int h = hashFunction(key, header.a, header.b, header.size);
+            if (dir.slots[header.offset + h] == key) return true;
+            return header.stashSize && stashContains(dir.slots + header.offset + header.size, header.stashSize, key);
+        }
+        
+        // Level 2: Search in secondary table
+        const SecondaryTable* secTable = dir.tables[bucketIdx].load(memory_order_seq_cst);
+        
+        if (!secTable) return false;
+        
+        // Atomic load: erase may be clearing this slot
+        int h = hashFunction(key, secTable->a, secTable->b, secTable->size);
+        if (__atomic_load_n(&secTable->table[h], __ATOMIC_RELAXED) == key) return true;
+        return !secTable->stash.empty() && stashContains(secTable->stash.data(), secTable->stash.size(), key);
+    }
+    
+    // Batched lookup: out[i] = search(keys[i]). On a frozen table keys are
+    // processed in tiles of 64 in three passes (Level 1 hash + header prefetch,
+    // Level 2 hash + slot prefetch, compare), so the cache misses of a whole
+    // tile overlap instead of serializing. Multiply-shift hashes are computed
+    // 16 or 8 keys at a time with AVX-512 or AVX2 when compiled for them.
+    void searchBatch(const int* keys, size_t n, uint8_t* out) const {
+        EpochDomain::ReadGuard guard;
+        const PendingBuffer* buffer = pending.load(memory_order_seq_cst);
+        const Directory& dir = localReplica(*directory.load(memory_order_seq_cst));
+        
+        if (!dir.frozen) {
+            for (size_t i = 0; i < n; i++) out[i] = searchIn(dir, keys[i]) || pendingContains(buffer, keys[i]);
+            return;
+        }
+        
+        const BucketHeader* headers = dir.headers;
+        const int* slots = dir.slots;
+        bool minusOne = holdsMinusOne.load(memory_order_acquire);
+        
+        const size_t TILE = 64;
+        uint32_t bucketOf[TILE];
+        uint32_t slotOf[TILE];  // NO_SLOT for keys landing in an empty or one-slot bucket
+        
+        for (size_t base = 0; base < n; base += TILE) {
+            const int* tile = keys + base;
+            size_t count = min(TILE, n - base);
+            
+            // Pass 1: Level 1 bucket of every key, then prefetch its header
+            size_t i = primaryHashBatch(dir, tile, count, bucketOf);
+            for (; i < count; i++) bucketOf[i] = hashFunction(tile[i], dir.a1, dir.b1, dir.primarySize);
+            for (i = 0; i < count; i++) __builtin_prefetch(&headers[bucketOf[i]]);
+            
+            // Pass 2: Level 2 slot of every key, then prefetch the slot
+            i = secondaryHashBatch(dir, tile, count, bucketOf, slotOf);
+            for (; i < count; i++) {
+                const BucketHeader& header = headers[bucketOf[i]];
+                slotOf[i] = header.size <= 1 ? NO_SLOT
+                          : header.offset + hashFunction(tile[i], header.a, header.b, header.size);
+            }
+            for (i = 0; i < count; i++) {
+                if (slotOf[i] != NO_SLOT) __builtin_prefetch(&slots[slotOf[i]]);
+            }
+            
+            // Pass 3: compare (against the inline key for one-slot tables),
+            // then scan the stash of a missed key's bucket
+            for (i = 0; i < count; i++) {
+                const BucketHeader& header = headers[bucketOf[i]];
+                bool hit;
+                if (tile[i] == EMPTY_SLOT) {
+                    hit = minusOne;
+                } else if (slotOf[i] == NO_SLOT) {
+                    hit = header.size == 1 && header.inlineKey == tile[i];
+                } else {
+                    hit = slots[slotOf[i]] == tile[i] ||
+                          (header.stashSize && stashContains(slots + header.offset + header.size, header.stashSize, tile[i]));
+                }
+                out[base + i] = hit;
+            }
+        }
+    }
+    
+private:
+    static const uint32_t NO_SLOT = UINT32_MAX;
+    
+    // Vector kernels for the multiply-shift family. Each returns how many
+    // leading keys it handled; the scalar loop in searchBatch finishes the rest.
+    // With a = aHi·2^32 + aLo and 32-bit x:
+    //   (a*x + b) >> 32 = ((aLo*x + b) >> 32) + aHi*x   (mod 2^32)
+    // so one 32x32->64 multiply per key plus one low multiply gives the hash.
+    // Header fields are gathered as 32-bit words: a = 0-1, b = 2-3, offset = 4, size = 5
+    // (stashSize = 6 is only read in the scalar compare pass).
+    static_assert(sizeof(BucketHeader) == 32, "gather indices assume 8 words per header");
+    
+#if defined(__AVX512F__)
+    static __m512i mulAddShift16(__m512i x, __m512i aLo, __m512i aHi, __m512i bEven, __m512i bOdd) {
+        __m512i even = _mm512_srli_epi64(_mm512_add_epi64(_mm512_mul_epu32(x, aLo), bEven), 32);
+        __m512i odd = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(x, 32), _mm512_srli_epi64(aLo, 32)), bOdd);
+        __m512i h = _mm512_mask_blend_epi32(0xAAAA, even, odd);
+        return _mm512_add_epi32(h, _mm512_mullo_epi32(x, aHi));
+    }
+    
+    static __m512i fastRange16(__m512i h, __m512i m) {
+        __m512i even = _mm512_srli_epi64(_mm512_mul_epu32(h, m), 32);
+        __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(h, 32), _mm512_srli_epi64(m, 32));
+        return _mm512_mask_blend_epi32(0xAAAA, even, odd);
+    }
+#elif defined(__AVX2__)
+    static __m256i mulAddShift8(__m256i x, __m256i aLo, __m256i aHi, __m256i bEven, __m256i bOdd) {
+        __m256i even = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epu32(x, aLo), bEven), 32);
+        __m256i odd = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(aLo, 32)), bOdd);
+        __m256i h = _mm256_blend_epi32(even, odd, 0xAA);
+        return _mm256_add_epi32(h, _mm256_mullo_epi32(x, aHi));
+    }
+    
+    static __m256i fastRange8(__m256i h, __m256i m) {
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(h, m), 32);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(h, 32), _mm256_srli_epi64(m, 32));
+        return _mm256_blend_epi32(even, odd, 0xAA);
+    }
+#endif
+    
+    size_t primaryHashBatch(const Directory& dir, const int* keys, size_t n, uint32_t* bucketOut) const {
+        size_t i = 0;
+        if (family != MULTIPLY_SHIFT) return i;
+        uint64_t a1 = dir.a1, b1 = dir.b1;
+        int primarySize = dir.primarySize;
+#if defined(__AVX512F__)
+        __m512i aLo = _mm512_set1_epi32((uint32_t)a1), aHi = _mm512_set1_epi32((uint32_t)(a1 >> 32));
+        __m512i b = _mm512_set1_epi64(b1), m = _mm512_set1_epi32(primarySize);
+        for (; i + 16 <= n; i += 16) {
+            __m512i x = _mm512_loadu_si512(keys + i);
+            _mm512_storeu_si512(bucketOut + i, fastRange16(mulAddShift16(x, aLo, aHi, b, b), m));
+        }
+#elif defined(__AVX2__)
+        __m256i aLo = _mm256_set1_epi32((uint32_t)a1), aHi = _mm256_set1_epi32((uint32_t)(a1 >> 32));
+        __m256i b = _mm256_set1_epi64x(b1), m = _mm256_set1_epi32(primarySize);
+        for (; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(keys + i));
+            _mm256_storeu_si256((__m256i*)(bucketOut + i), fastRange8(mulAddShift8(x, aLo, aHi, b, b), m));
+        }
+#else
+        (void)a1; (void)b1; (void)primarySize; (void)keys; (void)n; (void)bucketOut;
+#endif
+        return i;
+    }
+    
+    size_t secondaryHashBatch(const Directory& dir, const int* keys, size_t n,
+                              const uint32_t* bucketOf, uint32_t* slotOut) const {
+        size_t i = 0;
+        // 32-bit gather indices address header words as bucket*8
+        if (family != MULTIPLY_SHIFT || dir.primarySize >= (1 << 28)) return i;
+#if defined(__AVX512F__)
+        const int* words = (const int*)dir.headers;
+        for (; i + 16 <= n; i += 16) {
+            __m512i x = _mm512_loadu_si512(keys + i);
+            __m512i idx = _mm512_slli_epi32(_mm512_loadu_si512(bucketOf + i), 3);
+            __m512i aLo = _mm512_i32gather_epi32(idx, words, 4);
+            __m512i aHi = _mm512_i32gather_epi32(_mm512_add_epi32(idx, _mm512_set1_epi32(1)), words, 4);
+            __m512i bLo = _mm512_i32gather_epi32(_mm512_add_epi32(idx, _mm512_set1_epi32(2)), words, 4);
+            __m512i bHi = _mm512_i32gather_epi32(_mm512_add_epi32(idx, _mm512_set1_epi32(3)), words, 4);
+            __m512i offset = _mm512_i32gather_epi32(_mm512_add_epi32(idx, _mm512_set1_epi32(4)), words, 4);
+            __m512i size = _mm512_i32gather_epi32(_mm512_add_epi32(idx, _mm512_set1_epi32(5)), words, 4);
+            
+            __m512i bEven = _mm512_mask_blend_epi32(0xAAAA, bLo, _mm512_slli_epi64(bHi, 32));
+            __m512i bOdd = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(bLo, 32), bHi);
+            __m512i slot = _mm512_add_epi32(offset, fastRange16(mulAddShift16(x, aLo, aHi, bEven, bOdd), size));
+            
+            __mmask16 noSlot = _mm512_cmplt_epu32_mask(size, _mm512_set1_epi32(2));
+            _mm512_storeu_si512(slotOut + i, _mm512_mask_mov_epi32(slot, noSlot, _mm512_set1_epi32(-1)));
+        }
+#elif defined(__AVX2__)
+        const int* words = (const int*)dir.headers;
+        for (; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(keys + i));
+            __m256i idx = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(bucketOf + i)), 3);
+            __m256i aLo = _mm256_i32gather_epi32(words, idx, 4);
+            __m256i aHi = _mm256_i32gather_epi32(words + 1, idx, 4);
+            __m256i bLo = _mm256_i32gather_epi32(words + 2, idx, 4);
+            __m256i bHi = _mm256_i32gather_epi32(words + 3, idx, 4);
+            __m256i offset = _mm256_i32gather_epi32(words + 4, idx, 4);
+            __m256i size = _mm256_i32gather_epi32(words + 5, idx, 4);
+            
+            __m256i bEven = _mm256_blend_epi32(bLo, _mm256_slli_epi64(bHi, 32), 0xAA);
+            __m256i bOdd = _mm256_blend_epi32(_mm256_srli_epi64(bLo, 32), bHi, 0xAA);
+            __m256i slot = _mm256_add_epi32(offset, fastRange8(mulAddShift8(x, aLo, aHi, bEven, bOdd), size));
+            
+            __m256i noSlot = _mm256_cmpgt_epi32(_mm256_set1_epi32(2), size);
+            _mm256_storeu_si256((__m256i*)(slotOut + i), _mm256_or_si256(slot, noSlot));
+        }
+#else
+        (void)keys; (void)n; (void)bucketOf; (void)slotOut;
+#endif
+        return i;
+    }
+    
+public:
+    // Read-only view of one bucket, served from whichever layout is live
+    struct BucketView {
+        int size;
+        uint64_t a, b;
+        const int* table;
+        int stashSize;
+        const int* stash;
+    };
+    
+    BucketView bucketView(int i) const {
+        const Directory* dir = directory.load(memory_order_acquire);
+        if (dir->frozen) {
+            const BucketHeader& header = dir->headers[i];
+            const int* table = header.size == 1 ? &header.inlineKey : dir->slots + header.offset;
+            return {(int)header.size, header.a, header.b, table, (int)header.stashSize, table + header.size};
+        }
+        const SecondaryTable* secTable = dir->tables[i].load(memory_order_acquire);
+        if (!secTable) return {0, 0, 0, nullptr, 0, nullptr};
+        return {secTable->size, secTable->a, secTable->b, secTable->table.data(),
+                (int)secTable->stash.size(), secTable->stash.data()};
+    }
+    
+    // Key count of a bucket; counted from the occupied slots once the key lists are dropped
+    int bucketKeyCount(int i) const {
+        if (!bucketsDropped) return buckets[i].size();
+        BucketView view = bucketView(i);
+        return view.stashSize + count_if(view.table, view.table + view.size, [](int slot) { return slot != EMPTY_SLOT; });
+    }
+    
+    // Display the hash table structure (writer side: not concurrent with insert)
+    void display() {
+        int primarySize = primaryBuckets();
+        bool frozen = isFrozen();
+        
+        cout << "\n=== Perfect Hashing (FKS Algorithm) Structure ===\n";
+        cout << "Primary Level: " << primarySize << " buckets";
+        if (frozen) cout << " (frozen" << (bucketsDropped ? ", read-only" : "") << ")";
+        cout << "\n\n";
+        if (holdsMinusOne.load(memory_order_relaxed)) cout << "Key -1 (held outside the buckets)\n\n";
+        
+        for (int i = 0; i < primarySize; i++) {
+            BucketView view = bucketView(i);
+            int keyCount = bucketKeyCount(i);
+            
+            cout << "Bucket " << i << " (";
+            cout << keyCount << " keys): ";
+            
+            if (bucketsDropped) {
+                for (int j = 0; j < view.size; j++) {
+                    if (view.table[j] != EMPTY_SLOT) cout << view.table[j] << " ";
+                }
+                for (int j = 0; j < view.stashSize; j++) cout << view.stash[j] << " ";
+            } else {
+                for (int key : buckets[i]) {
+                    cout << key << " ";
+                }
+            }
+            cout << "\n";
+            
+            if (keyCount > 0) {
+                cout << "  Secondary Table Size: " << view.size;
+                if (family == MODULO_PRIME) cout << " | Hash Function: ((a*x + b) mod " << PRIME << ") mod m\n";
+                else cout << " | Hash Function: fastrange((a*x + b) >> 32, m)\n";
+                cout << "  Parameters: a=" << view.a;
+                cout << ", b=" << view.b << "\n";
+                
+                cout << "  Table Contents: [";
+                for (int j = 0; j < min(view.size, 10); j++) {
+                    if (view.table[j] != EMPTY_SLOT) {
+                        cout << "(" << j << ":" << view.table[j] << ") ";
+                    }
+                }
+                if (view.size > 10) cout << "...";
+                cout << "]\n";
+                if (view.stashSize > 0) {
+                    cout << "  Stash: [";
+                    for (int j = 0; j < view.stashSize; j++) cout << view.stash[j] << " ";
+                    cout << "]\n";
+                }
+            }
+        }
+        cout << "\n";
+    }
+    
+    // Bytes held by the frozen layout (headers and slot array); 0 if not frozen
+    size_t memoryBytes() const {
+        const Directory* dir = directory.load(memory_order_acquire);
+        if (!dir->frozen) return 0;
+        return (size_t)dir->primarySize * sizeof(BucketHeader) + dir->slotCount * sizeof(int);
+    }
+    
+    // Statistics (writer side: not concurrent with insert)
+    void statistics() {
+        const Directory* dir = directory.load(memory_order_acquire);
+        int primarySize = dir->primarySize;
+        
+        cout << "\n=== Hash Table Statistics ===\n";
+        double avgBucketSize = 0;
+        int maxBucketSize = 0;
+        
+        for (int i = 0; i < primarySize; i++) {
+            maxBucketSize = max(maxBucketSize, bucketKeyCount(i));
+        }
+        
+        avgBucketSize = (double)totalKeys / primarySize;
+        
+        cout << "Total Keys: " << totalKeys << "\n";
+        cout << "Primary Table Size: " << primarySize << "\n";
+        cout << "Average Bucket Size: " << fixed << setprecision(2) << avgBucketSize << "\n";
+        cout << "Max Bucket Size: " << maxBucketSize << "\n";
+        cout << "Load Factor: " << fixed << setprecision(2) << (double)totalKeys / primarySize << "\n";
+        cout << "Secondary Slots (sum of k²): " << sumSquares
+             << " (bound " << (long long)SUM_SQUARES_FACTOR * totalKeys << ")\n";
+        cout << "Empty Slots: " << sumSquares - totalKeys << " (" << fixed << setprecision(1)
+             << 100.0 * (sumSquares - totalKeys) / max(1LL, sumSquares) << "% of slots)\n";
+        cout << "Global Rehashes: " << rehashCount << "\n";
+        if (dir->frozen) {
+            size_t bytes = memoryBytes();
+            cout << "Frozen Layout: " << bytes << " bytes (" << fixed << setprecision(2)
+                 << (double)bytes / max(1, totalKeys) << " bytes/key"
+                 << (dir->hugePages ? ", huge pages" : dir->mapping ? ", memory-mapped" : "") << ")\n";
+            if (!dir->replicas.empty()) {
+                cout << "NUMA Replicas: " << count_if(dir->replicas.begin(), dir->replicas.end(),
+                                                      [](const unique_ptr<Directory>& r) { return r != nullptr; })
+                     << " nodes\n";
+            }
+        }
+        cout << "\n";
+    }
+};
 
-class PerfectHashing {
+// 128-bit multiply folded to 64 bits, the mixing step of the byte hash below
+inline uint64_t mulFold(uint64_t x, uint64_t y) {
+    __uint128_t product = (__uint128_t)x * y;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+// Fast 64-bit hash of a byte string: 16 bytes per multiply, seeded
+inline uint64_t hashBytes(const void* data, size_t length, uint64_t seed) {
+    const uint64_t K0 = 0xa0761d6478bd642fULL, K1 = 0xe7037ed1a0b428dbULL, K2 = 0x8ebc6af09c88c6e3ULL;
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = seed ^ K0 ^ (length * K2);
+    
+    for (; length > 16; length -= 16, p += 16) {
+        uint64_t w0, w1;
+        memcpy(&w0, p, 8);
+        memcpy(&w1, p + 8, 8);
+        h = mulFold(w0 ^ K1, w1 ^ h);
+    }
+    
+    // Last 1..16 bytes, zero padded
+    uint64_t tail[2] = {0, 0};
+    memcpy(tail, p, length);
+    h = mulFold(tail[0] ^ K1, tail[1] ^ h);
+    return mulFold(h ^ K2, h ^ K0);
+}
+
+// Default hashers for PerfectHashMap: hash(key, seed) -> 64 bits. Integer
+// keys go through a bijective mixer, so distinct keys never share a hash;
+// strings are read once by hashBytes.
+template <class Key, class Enable = void>
+struct KeyHasher;
+
+template <class Key>
+struct KeyHasher<Key, typename enable_if<is_integral<Key>::value>::type> {
+    uint64_t operator()(Key key, uint64_t seed) const {
+        uint64_t z = (uint64_t)key ^ seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+template <>
+struct KeyHasher<string> {
+    uint64_t operator()(const string& key, uint64_t seed) const {
+        return hashBytes(key.data(), key.size(), seed);
+    }
+};
+
+template <>
+struct KeyHasher<string_view> {
+    uint64_t operator()(string_view key, uint64_t seed) const {
+        return hashBytes(key.data(), key.size(), seed);
+    }
+};
+
+/*
+    Static FKS map from arbitrary keys to values.
+    
+    Each key is hashed once to 64 bits and both levels are multiply-shift
+    functions of that hash, so a string is read once per lookup. Keys and
+    values live in parallel slot arrays; a hit costs one header, one key
+    compare and returns a pointer into the value array.
+    
+    There is no empty sentinel, so every key value is storable. An empty slot
+    holds a copy of a key from its own bucket: that key hashes to its real
+    slot, never to the copy, so a lookup can't match an empty slot. Value must
+    be default constructible to fill empty slots.
+*/
+template <class Key, class Value, class Hasher = KeyHasher<Key>>
+class PerfectHashMap {
 private:
-    struct SecondaryTable {
-        vector<int> table;
-        int size;
-        int a, b, p;  // Hash function parameters: (a*x + b) % p
-        
-        SecondaryTable() : size(0), a(0), b(0), p(0) {}
+    struct BucketHeader {
+        uint64_t a, b;
+        uint32_t offset;
+        uint32_t size;
     };
     
-    vector<vector<int>> buckets;        // Level 1: Primary buckets
-    vector<SecondaryTable> secondLevel; // Level 2: Secondary hash tables
+    vector<BucketHeader> headers;
+    vector<Key> keys;
+    vector<Value> values;
+    Hasher hasher;
+    uint64_t hashSeed;
+    uint64_t a1, b1;
+    size_t keyCount;
+    int rebuilds;
+    SplitMix64 rng;
     
-    int primarySize;
-    int a1, b1, p1;  // Level 1 hash function parameters
+    static const int SUM_SQUARES_FACTOR = 4;
     
-    const long long MOD = 1e9 + 7;
-    const long long PRIME = 2147483647LL; // Large prime for universal hashing
+    static uint32_t reduce(uint64_t h, uint64_t a, uint64_t b, uint32_t tableSize) {
+        return (((a * h + b) >> 32) * tableSize) >> 32;
+    }
+    
+    // One build attempt with the current hash seed. Fails only if two
+    // different keys share a 64-bit hash or a bucket runs out of attempts.
+    bool tryBuild(const vector<pair<Key, Value>>& entries) {
+        size_t n = entries.size();
+        uint32_t primarySize = max<size_t>(1, n);
+        
+        vector<uint64_t> hashes(n);
+        for (size_t i = 0; i < n; i++) hashes[i] = hasher(entries[i].first, hashSeed);
+        
+        // Level 1: retry until the sum of squared bucket sizes is linear
+        vector<uint32_t> bucketOf(n);
+        vector<uint32_t> start(primarySize + 1);
+        for (;;) {
+            a1 = rng.next();
+            b1 = rng.next();
+            fill(start.begin(), start.end(), 0);
+            for (size_t i = 0; i < n; i++) start[(bucketOf[i] = reduce(hashes[i], a1, b1, primarySize)) + 1]++;
+            
+            long long sumSquares = 0;
+            for (uint32_t i = 1; i <= primarySize; i++) sumSquares += (long long)start[i] * start[i];
+            if (sumSquares <= SUM_SQUARES_FACTOR * (long long)max<size_t>(1, n)) break;
+        }
+        for (uint32_t i = 0; i < primarySize; i++) start[i + 1] += start[i];
+        
+        // Counting sort of entry indices by bucket, stable within a bucket
+        vector<uint32_t> order(n);
+        vector<uint32_t> cursor(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < n; i++) order[cursor[bucketOf[i]]++] = i;
+        
+        headers.assign(primarySize, BucketHeader());
+        keys.clear();
+        values.clear();
+        keyCount = 0;
+        
+        vector<uint64_t> bits;
+        vector<uint32_t> members;
+        for (uint32_t i = 0; i < primarySize; i++) {
+            // Drop repeated keys (the first one wins); equal hashes of
+            // different keys need a new hash seed
+            members.assign(order.begin() + start[i], order.begin() + start[i + 1]);
+            stable_sort(members.begin(), members.end(),
+                        [&](uint32_t x, uint32_t y) { return hashes[x] < hashes[y]; });
+            size_t k = 0;
+            for (size_t j = 0; j < members.size(); j++) {
+                if (k > 0 && hashes[members[k - 1]] == hashes[members[j]]) {
+                    if (entries[members[k - 1]].first == entries[members[j]].first) continue;
+                    return false;
+                }
+                members[k++] = members[j];
+            }
+            members.resize(k);
+            
+            BucketHeader& header = headers[i];
+            header.offset = keys.size();
+            header.size = k <= 1 ? k : k * k;
+            if (k == 0) continue;
+            
+            // Level 2: find a collision-free function on k² slots
+            bool placed = (k == 1);
+            for (int attempt = 0; !placed && attempt < 100; attempt++) {
+                header.a = rng.next();
+                header.b = rng.next();
+                bits.assign((header.size + 63) / 64, 0);
+                placed = true;
+                for (uint32_t idx : members) {
+                    uint32_t h = reduce(hashes[idx], header.a, header.b, header.size);
+                    if (bits[h >> 6] >> (h & 63) & 1) {
+                        placed = false;
+                        break;
+                    }
+                    bits[h >> 6] |= 1ULL << (h & 63);
+                }
+            }
+            if (!placed) return false;
+            
+            keys.insert(keys.end(), header.size, entries[members[0]].first);
+            values.insert(values.end(), header.size, Value());
+            for (uint32_t idx : members) {
+                uint32_t slot = header.offset + (k == 1 ? 0 : reduce(hashes[idx], header.a, header.b, header.size));
+                keys[slot] = entries[idx].first;
+                values[slot] = entries[idx].second;
+            }
+            keyCount += k;
+        }
+        return true;
+    }
     
 public:
-    PerfectHashing(int n = 10) : primarySize(n) {
-        buckets.resize(primarySize);
-        secondLevel.resize(primarySize);
+    // Build from (key, value) pairs; for repeated keys the first pair wins
+    explicit PerfectHashMap(const vector<pair<Key, Value>>& entries,
+                            uint64_t seedValue = PerfectHashing::randomSeed(), Hasher hash = Hasher())
+        : hasher(hash), hashSeed(0), a1(0), b1(0), keyCount(0), rebuilds(0), rng(seedValue) {
+        hashSeed = rng.next();
+        while (!tryBuild(entries)) {
+            hashSeed = rng.next();
+            rebuilds++;
+        }
+    }
+    
+    // Value stored under key, or nullptr if the key is absent
+    const Value* find(const Key& key) const {
+        uint64_t h = hasher(key, hashSeed);
+        const BucketHeader& header = headers[reduce(h, a1, b1, headers.size())];
+        if (header.size == 0) return nullptr;
         
-        // Initialize Level 1 hash function randomly
-        randomizeHashFunction(a1, b1, p1, PRIME);
+        uint32_t slot = header.offset + reduce(h, header.a, header.b, header.size);
+        return keys[slot] == key ? &values[slot] : nullptr;
     }
     
-    // Universal hash function: h(x) = (a*x + b) mod p
-    int hashFunction(int key, int a, int b, long long p) {
-        return ((long long)a * key + b) % p;
+    bool contains(const Key& key) const {
+        return find(key) != nullptr;
     }
     
-    // Generate random hash function parameters
-    void randomizeHashFunction(int& a, int& b, long long& p, long long prime) {
-        srand(time(0) + rand());
-        a = 1 + rand() % (prime - 1);
-        b = rand() % prime;
-        p = prime;
+    size_t size() const {
+        return keyCount;
     }
     
-    // Check if hash function h is collision-free for given keys
-    bool isCollisionFree(const vector<int>& keys, int a, int b, long long p, int tableSize) {
-        unordered_set<int> hashed;
-        for (int key : keys) {
-            int h = hashFunction(key, a, b, p) % tableSize;
-            if (hashed.count(h)) return false;
-            hashed.insert(h);
-        }
-        return true;
+    // Display statistics; bytes exclude memory a key or value owns elsewhere
+    // (e.g. long string contents)
+    void statistics() const {
+        size_t bytes = headers.size() * sizeof(BucketHeader) + keys.size() * (sizeof(Key) + sizeof(Value));
+        cout << "\n=== Perfect Hash Map Statistics ===\n";
+        cout << "Total Keys: " << keyCount << "\n";
+        cout << "Primary Table Size: " << headers.size() << "\n";
+        cout << "Slots: " << keys.size() << " (" << fixed << setprecision(2)
+             << (double)keys.size() / max<size_t>(1, keyCount) << " per key)\n";
+        cout << "Hash Seed Changes: " << rebuilds << "\n";
+        cout << "Layout: " << bytes << " bytes (" << (double)bytes / max<size_t>(1, keyCount) << " bytes/key)\n\n";
     }
+};
+
+/*
+    Minimal-space static set (PTHash-style), the read-only alternative to the
+    k² FKS layout when memory matters more than a fixed probe bound.
     
-    // Build the secondary hash table for a bucket
-    bool buildSecondaryTable(int bucketIdx) {
-        vector<int>& keys = buckets[bucketIdx];
-        int k = keys.size();
+    Keys are hashed to 64 bits and split skewed into about c·n/log2(n)
+    buckets (60% of keys into 30% of buckets, so the hard buckets are tried
+    first while the table is still empty). Each bucket stores one 16-bit
+    pilot p chosen so that every key of the bucket lands on a free slot of
+    
+        position(x) = fastrange(mix(h(x) ⊕ p·φ), n / α)
+    
+    The slot array has n / α entries (α = 0.98, near-minimal) holding the
+    keys themselves, so search() can reject keys that were never inserted.
+    A lookup reads one pilot and one slot, the same two accesses as FKS;
+    the pilots cost about 16·c / log2(n) bits per key on top of the keys.
+*/
+class CompactPerfectHashing {
+private:
+    vector<uint16_t> pilots;
+    vector<int> slots;  // Empty slots repeat a stored key, which maps elsewhere
+    uint64_t seed;
+    uint32_t bucketCount;
+    uint32_t denseBuckets;  // Buckets receiving the dense 60% of keys
+    uint32_t tableSize;
+    int totalKeys;
+    SplitMix64 rng;
+    
+    static constexpr double BUCKETS_PER_KEY_LOG = 5.0;  // c
+    static constexpr double LOAD_FACTOR = 0.98;          // α
+    static const uint32_t DENSE_THRESHOLD = 2576980377U; // 0.6 · 2^32
+    static const uint64_t PILOT_MULTIPLIER = 0x9e3779b97f4a7c15ULL;
+    
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    
+    uint64_t keyHash(int key) const {
+        return mix((uint32_t)key ^ seed);
+    }
+    
+    uint32_t bucketOf(uint64_t h) const {
+        uint64_t hi = h >> 32;
+        if ((uint32_t)h < DENSE_THRESHOLD) return (hi * denseBuckets) >> 32;
+        return denseBuckets + ((hi * (bucketCount - denseBuckets)) >> 32);
+    }
+    
+    uint32_t position(uint64_t h, uint16_t pilot) const {
+        return ((__uint128_t)mix(h ^ (pilot * PILOT_MULTIPLIER)) * tableSize) >> 64;
+    }
+    
+    // One build attempt with the current seed; fails if some bucket finds
+    // no pilot in 16 bits
+    bool tryBuild(const vector<int>& keys, PerfectHashing::BuildReport& report) {
+        size_t n = keys.size();
+        double logN = max(1.0, log2((double)n));
+        bucketCount = max<uint32_t>(2, ceil(BUCKETS_PER_KEY_LOG * n / logN));
+        denseBuckets = max<uint32_t>(1, bucketCount * 0.3);
+        tableSize = max<uint32_t>(1, ceil(n / LOAD_FACTOR));
         
-        if (k == 0) {
-            secondLevel[bucketIdx].size = 0;
-            return true;
+        // Group key hashes by bucket
+        vector<uint64_t> hashes(n);
+        vector<uint32_t> start(bucketCount + 1, 0);
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = keyHash(keys[i]);
+            start[bucketOf(hashes[i]) + 1]++;
         }
+        for (uint32_t b = 0; b < bucketCount; b++) start[b + 1] += start[b];
+        vector<uint64_t> grouped(n);
+        vector<uint32_t> cursor(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < n; i++) grouped[cursor[bucketOf(hashes[i])]++] = hashes[i];
         
-        if (k == 1) {
-            // Single element - no collision possible
-            secondLevel[bucketIdx].table.resize(1);
-            secondLevel[bucketIdx].table[0] = keys[0];
-            secondLevel[bucketIdx].size = 1;
-            secondLevel[bucketIdx].a = 1;
-            secondLevel[bucketIdx].b = 0;
-            secondLevel[bucketIdx].p = PRIME;
-            return true;
-        }
+        // Largest buckets first
+        vector<uint32_t> order(bucketCount);
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+            return start[x + 1] - start[x] > start[y + 1] - start[y];
+        });
         
-        // Try to find a collision-free hash function
-        // Secondary table size is k²
-        int secondarySize = k * k;
-        int attempts = 0;
-        int maxAttempts = 100;  // Limit attempts to avoid infinite loop
-        
-        while (attempts < maxAttempts) {
-            int a, b;
-            randomizeHashFunction(a, b, secondLevel[bucketIdx].p, PRIME);
-            
-            if (isCollisionFree(keys, a, b, PRIME, secondarySize)) {
-                // Found a collision-free hash function
-                secondLevel[bucketIdx].table.assign(secondarySize, -1);
-                secondLevel[bucketIdx].size = secondarySize;
-                secondLevel[bucketIdx].a = a;
-                secondLevel[bucketIdx].b = b;
-                
-                // Place keys in secondary table
-                for (int key : keys) {
-                    int h = hashFunction(key, a, b, PRIME) % secondarySize;
-                    secondLevel[bucketIdx].table[h] = key;
+        pilots.assign(bucketCount, 0);
+        vector<uint64_t> taken((tableSize + 63) / 64, 0);
+        vector<uint32_t> placed;
+        for (uint32_t b : order) {
+            uint32_t size = start[b + 1] - start[b];
+            if (size == 0) break;
+            
+            bool found = false;
+            for (uint32_t pilot = 0; pilot <= UINT16_MAX && !found; pilot++) {
+                placed.clear();
+                found = true;
+                for (uint32_t j = start[b]; j < start[b + 1]; j++) {
+                    uint32_t p = position(grouped[j], pilot);
+                    if (taken[p >> 6] >> (p & 63) & 1) {
+                        found = false;
+                        break;
+                    }
+                    taken[p >> 6] |= 1ULL << (p & 63);
+                    placed.push_back(p);
+                }
+                if (!found) {
+                    for (uint32_t p : placed) taken[p >> 6] &= ~(1ULL << (p & 63));
+                    report.secondaryRetries++;
+                } else {
+                    pilots[b] = pilot;
                 }
-                
-                return true;
             }
-            attempts++;
+            if (!found) return false;
         }
         
-        return false;  // Couldn't find collision-free function
+        // Place the keys; empty slots get a copy of the first key
+        slots.assign(tableSize, n > 0 ? keys[0] : 0);
+        for (int key : keys) {
+            uint64_t h = keyHash(key);
+            slots[position(h, pilots[bucketOf(h)])] = key;
+        }
+        return true;
     }
     
-    // Insert key into the perfect hash table
-    bool insert(int key) {
-        // Level 1: Insert into appropriate bucket
-        int bucketIdx = hashFunction(key, a1, b1, p1) % primarySize;
-        buckets[bucketIdx].push_back(key);
-        
-        // Level 2: Rebuild secondary table for this bucket
-        return buildSecondaryTable(bucketIdx);
+public:
+    CompactPerfectHashing(uint64_t seedValue = PerfectHashing::randomSeed())
+        : seed(0), bucketCount(0), denseBuckets(0), tableSize(0), totalKeys(0), rng(seedValue) {}
+    
+    CompactPerfectHashing(const vector<int>& keys, uint64_t seedValue = PerfectHashing::randomSeed())
+        : CompactPerfectHashing(seedValue) {
+        build(keys);
     }
     
-    // Search for a key in the perfect hash table
-    bool search(int key) {
-        // Level 1: Find the bucket
-        int bucketIdx = hashFunction(key, a1, b1, p1) % primarySize;
+    // Build the table from scratch; duplicate keys are stored once
+    PerfectHashing::BuildReport build(const vector<int>& keys) {
+        auto start = chrono::steady_clock::now();
+        PerfectHashing::BuildReport report;
         
-        // Level 2: Search in secondary table
-        const SecondaryTable& secTable = secondLevel[bucketIdx];
+        vector<int> unique(keys);
+        sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
         
-        if (secTable.size == 0) return false;
+        seed = rng.next();
+        while (!tryBuild(unique, report)) {
+            seed = rng.next();
+            report.primaryRetries++;
+        }
+        totalKeys = unique.size();
+        if (totalKeys == 0) slots.clear();
         
-        int h = hashFunction(key, secTable.a, secTable.b, secTable.p) % secTable.size;
-        return secTable.table[h] == key;
+        report.keys = totalKeys;
+        report.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return report;
     }
     
-    // Display the hash table structure
-    void display() {
-        cout << "\n=== Perfect Hashing (FKS Algorithm) Structure ===\n";
-        cout << "Primary Level: " << primarySize << " buckets\n\n";
+    bool search(int key) const {
+        if (slots.empty()) return false;
+        uint64_t h = keyHash(key);
+        return slots[position(h, pilots[bucketOf(h)])] == key;
+    }
+    
+    // Batched lookup in tiles of 64: hash and prefetch pilots, then compute
+    // positions and prefetch slots, then compare
+    void searchBatch(const int* keys, size_t n, uint8_t* out) const {
+        if (slots.empty()) {
+            fill(out, out + n, 0);
+            return;
+        }
         
-        for (int i = 0; i < primarySize; i++) {
-            cout << "Bucket " << i << " (";
-            cout << buckets[i].size() << " keys): ";
+        const size_t TILE = 64;
+        uint64_t hashOf[TILE];
+        uint32_t bucketIdx[TILE];
+        
+        for (size_t base = 0; base < n; base += TILE) {
+            const int* tile = keys + base;
+            size_t count = min(TILE, n - base);
             
-            for (int key : buckets[i]) {
-                cout << key << " ";
+            for (size_t i = 0; i < count; i++) {
+                hashOf[i] = keyHash(tile[i]);
+                bucketIdx[i] = bucketOf(hashOf[i]);
+                __builtin_prefetch(&pilots[bucketIdx[i]]);
             }
-            cout << "\n";
-            
-            if (buckets[i].size() > 0) {
-                cout << "  Secondary Table Size: " << secondLevel[i].size;
-                cout << " | Hash Function: (a*x + b) mod " << secondLevel[i].p << "\n";
-                cout << "  Parameters: a=" << secondLevel[i].a;
-                cout << ", b=" << secondLevel[i].b << "\n";
-                
-                cout << "  Table Contents: [";
-                for (int j = 0; j < min((int)secondLevel[i].table.size(), 10); j++) {
-                    if (secondLevel[i].table[j] != -1) {
-                        cout << "(" << j << ":" << secondLevel[i].table[j] << ") ";
-                    }
-                }
-                if (secondLevel[i].table.size() > 10) cout << "...";
-                cout << "]\n";
+            for (size_t i = 0; i < count; i++) {
+                bucketIdx[i] = position(hashOf[i], pilots[bucketIdx[i]]);
+                __builtin_prefetch(&slots[bucketIdx[i]]);
             }
+            for (size_t i = 0; i < count; i++) out[base + i] = slots[bucketIdx[i]] == tile[i];
         }
-        cout << "\n";
     }
     
-    // Statistics
-    void statistics() {
-        cout << "\n=== Hash Table Statistics ===\n";
-        int totalKeys = 0;
-        double avgBucketSize = 0;
-        int maxBucketSize = 0;
+    size_t memoryBytes() const {
+        return pilots.size() * sizeof(uint16_t) + slots.size() * sizeof(int);
+    }
+    
+    // Display statistics
+    void statistics() const {
+        cout << "\n=== Compact Perfect Hash Statistics ===\n";
+        cout << "Total Keys: " << totalKeys << "\n";
+        cout << "Buckets (pilots): " << bucketCount << "\n";
+        cout << "Table Size: " << slots.size() << " (load " << fixed << setprecision(2)
+             << (double)totalKeys / max<size_t>(1, slots.size()) << ")\n";
+        cout << "Empty Slots: " << slots.size() - min<size_t>(slots.size(), totalKeys) << "\n";
+        cout << "Pilots: " << (double)pilots.size() * 16 / max(1, totalKeys) << " bits/key\n";
+        cout << "Layout: " << memoryBytes() << " bytes ("
+             << (double)memoryBytes() / max(1, totalKeys) << " bytes/key)\n\n";
+    }
+};
+
+/*
+    FKS over a key set known at compile time. build() runs the same two
+    levels as PerfectHashing with multiply-shift hashing inside a constant
+    expression: Level 1 functions are drawn from a SplitMix64 seeded by the
+    caller until sum(k²) <= 4n, then every bucket gets a collision-free
+    function on k² slots. The parameters and slot array are plain members,
+    so a constexpr table costs nothing at startup and contains() on a
+    constant key folds away:
+    
+        constexpr auto OPCODES = makeStaticPerfectHashing({0x01, 0x0b, 0x1f, 0x42});
+        static_assert(OPCODES.valid() && OPCODES.contains(0x1f));
+    
+    Empty slots hold the first key, which maps to a slot of its own, so no
+    key value is reserved. A build over duplicate keys (or, with negligible
+    odds, one that runs out of attempts) returns a table whose valid() is
+    false; check it with static_assert.
+*/
+template <size_t N>
+class StaticPerfectHashing {
+    static_assert(N > 0, "a static table needs at least one key");
+    
+public:
+    static const size_t SLOT_CAPACITY = 4 * N;  // The sum(k²) <= 4n bound
+    
+    struct Bucket {
+        uint64_t a = 0, b = 0;  // Level 2 parameters
+        uint32_t offset = 0;    // First slot of this bucket in `slots`
+        uint32_t size = 0;      // k² for k keys, 0 for an empty bucket
+    };
+    
+private:
+    static const int PRIMARY_ATTEMPTS = 64;
+    static const int SECONDARY_ATTEMPTS = 64;  // Each succeeds with probability >= 1/2
+    
+    uint64_t a1 = 0, b1 = 0;
+    Bucket buckets[N] = {};
+    int slots[SLOT_CAPACITY] = {};
+    uint32_t slotCount = 0;
+    bool built = false;
+    
+public:
+    constexpr StaticPerfectHashing() {}
+    
+    static constexpr StaticPerfectHashing build(const int (&keys)[N], uint64_t seed) {
+        StaticPerfectHashing table;
+        SplitMix64 rng(seed);
         
-        for (int i = 0; i < primarySize; i++) {
-            totalKeys += buckets[i].size();
-            maxBucketSize = max(maxBucketSize, (int)buckets[i].size());
+        // Level 1: retry until the secondary tables fit in 4n slots
+        uint32_t bucketOf[N] = {};
+        uint32_t counts[N] = {};
+        bool fits = false;
+        for (int attempt = 0; attempt < PRIMARY_ATTEMPTS && !fits; attempt++) {
+            table.a1 = rng.next();
+            table.b1 = rng.next();
+            for (size_t i = 0; i < N; i++) counts[i] = 0;
+            for (size_t i = 0; i < N; i++) {
+                bucketOf[i] = multiplyShift(keys[i], table.a1, table.b1, N);
+                counts[bucketOf[i]]++;
+            }
+            uint64_t sumSquares = 0;
+            for (size_t i = 0; i < N; i++) sumSquares += (uint64_t)counts[i] * counts[i];
+            fits = sumSquares <= SLOT_CAPACITY;
         }
+        if (!fits) return table;
         
-        avgBucketSize = (double)totalKeys / primarySize;
+        // Lay the tables out in bucket order and group the keys by bucket
+        uint32_t first[N] = {};
+        for (size_t i = 0, offset = 0, cursor = 0; i < N; i++) {
+            table.buckets[i].offset = offset;
+            table.buckets[i].size = counts[i] * counts[i];
+            offset += table.buckets[i].size;
+            first[i] = cursor;
+            cursor += counts[i];
+        }
+        table.slotCount = table.buckets[N - 1].offset + table.buckets[N - 1].size;
+        int grouped[N] = {};
+        uint32_t fill[N] = {};
+        for (size_t i = 0; i < N; i++) grouped[first[bucketOf[i]] + fill[bucketOf[i]]++] = keys[i];
         
-        cout << "Total Keys: " << totalKeys << "\n";
-        cout << "Primary Table Size: " << primarySize << "\n";
-        cout << "Average Bucket Size: " << fixed << setprecision(2) << avgBucketSize << "\n";
-        cout << "Max Bucket Size: " << maxBucketSize << "\n";
-        cout << "Load Factor: " << fixed << setprecision(2) << (double)totalKeys / primarySize << "\n";
-        cout << "\n";
+        // Level 2: a function placing every key of the bucket on its own slot
+        bool used[SLOT_CAPACITY] = {};
+        for (size_t i = 0; i < N; i++) {
+            Bucket& bucket = table.buckets[i];
+            if (counts[i] == 0) continue;
+            bool placed = false;
+            for (int attempt = 0; attempt < SECONDARY_ATTEMPTS && !placed; attempt++) {
+                bucket.a = rng.next();
+                bucket.b = rng.next();
+                for (uint32_t j = 0; j < bucket.size; j++) used[bucket.offset + j] = false;
+                placed = true;
+                for (uint32_t j = 0; j < counts[i] && placed; j++) {
+                    uint32_t slot = bucket.offset + multiplyShift(grouped[first[i] + j], bucket.a, bucket.b, bucket.size);
+                    placed = !used[slot];
+                    used[slot] = true;
+                    table.slots[slot] = grouped[first[i] + j];
+                }
+            }
+            if (!placed) return table;
+        }
+        
+        for (uint32_t slot = 0; slot < table.slotCount; slot++) {
+            if (!used[slot]) table.slots[slot] = keys[0];
+        }
+        table.built = true;
+        return table;
+    }
+    
+    constexpr bool valid() const { return built; }
+    
+    constexpr bool contains(int key) const {
+        const Bucket& bucket = buckets[multiplyShift(key, a1, b1, N)];
+        return built && bucket.size && slots[bucket.offset + multiplyShift(key, bucket.a, bucket.b, bucket.size)] == key;
+    }
+    
+    // Slot holding key, or -1 if absent: a collision-free index into
+    // [0, slotsUsed()) for payload arrays kept alongside the table
+    constexpr int slotOf(int key) const {
+        const Bucket& bucket = buckets[multiplyShift(key, a1, b1, N)];
+        if (!built || bucket.size == 0) return -1;
+        uint32_t slot = bucket.offset + multiplyShift(key, bucket.a, bucket.b, bucket.size);
+        return slots[slot] == key ? (int)slot : -1;
     }
+    
+    constexpr size_t size() const { return N; }
+    constexpr size_t slotsUsed() const { return slotCount; }
+    constexpr const Bucket& bucket(size_t i) const { return buckets[i]; }
 };
 
-int main() {
+// Deduces N from a braced key list; any fixed seed gives a reproducible table
+template <size_t N>
+constexpr StaticPerfectHashing<N> makeStaticPerfectHashing(const int (&keys)[N], uint64_t seed = 0x5eed) {
+    return StaticPerfectHashing<N>::build(keys, seed);
+}
+
+// insert/build/search at every size up to maxSize for each key
+// distribution; lookups run at 100%, 50% and 0% hits on the dynamic table,
+// then on the frozen layout one key at a time and batched
+void runBenchmark(size_t maxSize) {
+    const size_t LOOKUPS = 1000000;
+    bench::Distribution dists[] = {bench::UNIFORM, bench::ZIPF, bench::ADVERSARIAL};
+    volatile size_t sink = 0;
+    
+    cout << "PerfectHashing (FKS) operations\n";
+    bench::printHeader();
+    for (size_t n : bench::benchSizes(maxSize)) {
+        for (bench::Distribution d : dists) {
+            vector<uint32_t> ids = bench::makeKeys(n, d);
+            vector<int> keys(ids.begin(), ids.end());
+            
+            size_t heapBefore = bench::AllocStats::liveBytes;
+            PerfectHashing table(1, PerfectHashing::MULTIPLY_SHIFT, 42);
+            bench::Result insert = bench::timeOps(n, [&](size_t i) { table.insert(keys[i]); });
+            double bytesPerKey = bench::COUNTS_ALLOCS ? (double)(bench::AllocStats::liveBytes - heapBefore) / n : -1;
+            bench::printRow("insert", d, n, -1, insert, bytesPerKey);
+            
+            PerfectHashing spread(1, PerfectHashing::MULTIPLY_SHIFT, 42);
+            spread.setIncrementalRebuild(true);
+            bench::Result incremental = bench::timeOps(n, [&](size_t i) { spread.insert(keys[i]); });
+            bench::printRow("insert (incremental)", d, n, -1, incremental, -1);
+            
+            PerfectHashing bulk(1, PerfectHashing::MULTIPLY_SHIFT, 42);
+            bench::Result build = bench::timeOps(1, [&](size_t) { bulk.build(keys); });
+            build.nsPerOp /= n;
+            build.p99Ns /= n;
+            build.allocsPerOp /= n;
+            bench::printRow("build (per key)", d, n, -1, build, -1);
+            
+            bulk.freeze(true);
+            double frozenBytesPerKey = (double)bulk.memoryBytes() / n;
+            
+            PerfectHashing huge(keys, PerfectHashing::MULTIPLY_SHIFT, 42);
+            huge.setHugePageLayout(true);
+            huge.freeze(true);
+            
+            for (int hitPercent : {100, 50, 0}) {
+                vector<uint32_t> probeIds = bench::makeProbes(ids, d, LOOKUPS, hitPercent / 100.0);
+                vector<int> probes(probeIds.begin(), probeIds.end());
+                
+                bench::Result search = bench::timeOps(LOOKUPS, [&](size_t j) { sink = sink + table.search(probes[j]); });
+                bench::printRow("search", d, n, hitPercent, search, bytesPerKey);
+                
+                bench::Result frozen = bench::timeOps(LOOKUPS, [&](size_t j) { sink = sink + bulk.search(probes[j]); });
+                bench::printRow("search (frozen)", d, n, hitPercent, frozen, frozenBytesPerKey);
+                
+                bench::Result onHuge = bench::timeOps(LOOKUPS, [&](size_t j) { sink = sink + huge.search(probes[j]); });
+                bench::printRow("search (huge pages)", d, n, hitPercent, onHuge, (double)huge.memoryBytes() / n);
+                
+                // One call per 64-key tile
+                const size_t TILE = 64;
+                uint8_t found[TILE];
+                bench::Result batch = bench::timeOps(LOOKUPS / TILE, [&](size_t t) {
+                    bulk.searchBatch(probes.data() + t * TILE, TILE, found);
+                    sink = sink + found[0];
+                });
+                batch.nsPerOp /= TILE;
+                batch.p99Ns /= TILE;
+                batch.allocsPerOp /= TILE;
+                bench::printRow("searchBatch (frozen)", d, n, hitPercent, batch, frozenBytesPerKey);
+            }
+        }
+    }
+}
+
+// --load <file|-> [out]: stream whitespace-separated int keys a chunk at a
+// time, bulk build a frozen table over them and optionally save it for
+// loadMapped
+int runLoad(const char* path, const char* outPath) {
+    auto start = chrono::steady_clock::now();
+    vector<int> keys;
+    bulk::LoadStats stats = bulk::readInts(path, [&](const int* batch, size_t n) {
+        keys.insert(keys.end(), batch, batch + n);
+    });
+    double readMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    if (!stats.opened) {
+        cout << "Cannot open " << path << "\n";
+        return 1;
+    }
+    // The bulk build expects a set
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    cout << "Read " << stats.records << " keys (" << keys.size() << " distinct, " << stats.skipped
+         << " malformed lines skipped) in " << fixed << setprecision(1) << readMs << " ms, "
+         << stats.bytes / max(1e-3, readMs) / 1e3 << " MB/s\n";
+    
+    PerfectHashing table(1, PerfectHashing::MULTIPLY_SHIFT);
+    PerfectHashing::BuildReport report = table.build(keys);
+    table.freeze(true);
+    cout << "Built in " << report.milliseconds << " ms on " << report.threads << " threads, "
+         << report.primaryRetries << " primary retries, " << report.stashedKeys << " stashed keys\n";
+    table.statistics();
+    
+    if (outPath) {
+        if (!table.save(outPath)) {
+            cout << "Cannot write " << outPath << "\n";
+            return 1;
+        }
+        cout << "Saved to " << outPath << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        runBenchmark(argc > 2 ? stoul(argv[2]) : 1000000);
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "--load") {
+        return runLoad(argv[2], argc > 3 ? argv[3] : nullptr);
+    }
+    
     cout << "============================================\n";
     cout << "  FKS Perfect Hashing Algorithm Demo\n";
     cout << "  Two-Level Perfect Hashing Implementation\n";
@@ -258,6 +2876,352 @@ int main() {
         }
     }
     
+    // Test Case 5: Steady insert traffic grows the primary level
+    cout << "\nTest 5: Inserting 2000 more keys one at a time\n";
+    int rehashReports = 0;
+    hashTable.setBuildObserver([&](const PerfectHashing::BuildReport& r) {
+        rehashReports++;
+        if (r.stashedBuckets > 0) cout << "Rehash stashed " << r.stashedKeys << " key(s)\n";
+    });
+    for (int i = 0; i < 2000; i++) hashTable.insert(1000 + i * 13);
+    hashTable.setBuildObserver(nullptr);
+    cout << "Observer saw " << rehashReports << " global rehash(es), last over "
+         << hashTable.lastBuildReport().keys << " keys\n";
+    hashTable.statistics();
+    
+    // Test Case 6: Bulk static build
+    cout << "\nTest 6: Bulk build over 100000 keys\n";
+    vector<int> bulkKeys;
+    for (int i = 0; i < 100000; i++) bulkKeys.push_back(i * 7 + 3);
+    
+    PerfectHashing staticTable;
+    staticTable.setBuildProfiling(true);
+    PerfectHashing::BuildReport report = staticTable.build(bulkKeys);
+    
+    cout << "Built " << report.keys << " keys in " << fixed << setprecision(2)
+         << report.milliseconds << " ms on " << report.threads << " thread(s)\n";
+    cout << "Level 1 retries: " << report.primaryRetries
+         << " | Level 2 retries: " << report.secondaryRetries
+         << " | Grown buckets: " << report.grownBuckets
+         << " | Stashed keys: " << report.stashedKeys << "\n";
+    cout << "Hashing: " << report.hashingMs << " ms | Collision checks: " << report.collisionCheckMs << " ms\n";
+    cout << "Slots: " << report.occupiedSlots << " occupied of " << report.totalSlots << "\n";
+    cout << "Bucket sizes:";
+    for (size_t k = 0; k < report.bucketSizeHistogram.size(); k++) {
+        cout << " " << k << "->" << report.bucketSizeHistogram[k];
+    }
+    auto slowest = max_element(report.bucketAttempts.begin(), report.bucketAttempts.end());
+    cout << "\nMost Level 2 retries: " << *slowest << " (bucket " << slowest - report.bucketAttempts.begin() << ")\n";
+    
+    // Same seed, same keys: the rebuild draws the same functions on any thread count
+    PerfectHashing replayA(5, PerfectHashing::MULTIPLY_SHIFT, 42), replayB(5, PerfectHashing::MULTIPLY_SHIFT, 42);
+    replayB.setBuildThreads(4);
+    int retriesA = replayA.build(bulkKeys).secondaryRetries;
+    int retriesB = replayB.build(bulkKeys).secondaryRetries;
+    cout << "Seed 42 rebuilt on 1 and 4 threads: " << retriesA << " vs " << retriesB
+         << " Level 2 retries" << (retriesA == retriesB ? " (reproducible)" : "") << "\n";
+    
+    staticTable.freeze(true);  // Flat read-only layout, key lists released
+    staticTable.statistics();
+    
+    int found = 0;
+    for (int key : bulkKeys) found += staticTable.search(key);
+    cout << "Found " << found << "/" << bulkKeys.size() << " keys, "
+         << (staticTable.search(4) ? "false positive on 4" : "no false positive on 4") << "\n";
+    
+    // Test Case 7: Lookup cost of each hash family on the frozen layout
+    cout << "\nTest 7: Lookup time per hash family, single and batched\n";
+    PerfectHashing::HashFamily families[] = {PerfectHashing::MODULO_PRIME, PerfectHashing::MULTIPLY_SHIFT};
+    const char* familyNames[] = {"modulo prime", "multiply-shift"};
+    
+    for (int f = 0; f < 2; f++) {
+        PerfectHashing familyTable(bulkKeys, families[f]);
+        familyTable.freeze(true);
+        
+        auto start = chrono::steady_clock::now();
+        int hits = 0;
+        for (int round = 0; round < 10; round++) {
+            for (int key : bulkKeys) hits += familyTable.search(key);
+        }
+        auto end = chrono::steady_clock::now();
+        
+        double ns = chrono::duration<double, nano>(end - start).count() / (10.0 * bulkKeys.size());
+        
+        vector<uint8_t> results(bulkKeys.size());
+        start = chrono::steady_clock::now();
+        for (int round = 0; round < 10; round++) {
+            familyTable.searchBatch(bulkKeys.data(), bulkKeys.size(), results.data());
+        }
+        end = chrono::steady_clock::now();
+        
+        double batchNs = chrono::duration<double, nano>(end - start).count() / (10.0 * bulkKeys.size());
+        int batchHits = count(results.begin(), results.end(), 1);
+        cout << familyNames[f] << ": " << fixed << setprecision(2) << ns << " ns/lookup, "
+             << batchNs << " ns/key batched (" << hits / 10 << " / " << batchHits << " hits)\n";
+    }
+    
+    // Test Case 8: Readers running while a single writer inserts and rehashes
+    cout << "\nTest 8: 4 reader threads during 20000 inserts\n";
+    PerfectHashing sharedTable(5);
+    atomic<int> published(-1);
+    atomic<bool> writerDone(false);
+    atomic<long long> lookups(0), misses(0);
+    
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+            unsigned state = t + 1;
+            long long localLookups = 0, localMisses = 0;
+            while (!writerDone.load()) {
+                int upTo = published.load();
+                if (upTo < 0) continue;
+                state = state * 1103515245 + 12345;
+                int i = state % (upTo + 1);
+                localMisses += !sharedTable.search(i * 11);  // Every published key must be found
+                localLookups++;
+            }
+            lookups += localLookups;
+            misses += localMisses;
+        });
+    }
+    
+    for (int i = 0; i < 20000; i++) {
+        sharedTable.insert(i * 11);
+        published.store(i);
+    }
+    writerDone.store(true);
+    for (thread& reader : readers) reader.join();
+    
+    cout << lookups.load() << " concurrent lookups, " << misses.load() << " missed published keys\n";
+    
+    // Test Case 9: Save the frozen table and map it back without copying
+    cout << "\nTest 9: Save and memory-map the frozen table\n";
+    string tablePath = "fks_table.bin";
+    PerfectHashing mappedTable;
+    if (staticTable.save(tablePath) && mappedTable.loadMapped(tablePath)) {
+        int mappedFound = 0;
+        for (int key : bulkKeys) mappedFound += mappedTable.search(key);
+        cout << "Mapped " << tablePath << ": found " << mappedFound << "/" << bulkKeys.size() << " keys\n";
+        mappedTable.statistics();
+    } else {
+        cout << "Could not save or map " << tablePath << "\n";
+    }
+    
+    PerfectHashing smallTable(vector<int>{10, 25, 35, 45});
+    smallTable.freeze();
+    if (smallTable.save(tablePath) && mappedTable.loadMapped(tablePath)) mappedTable.display();
+    
+    // Damaged files must be rejected, not mapped and then crashed on
+    ifstream imageIn(tablePath, ios::binary);
+    string image((istreambuf_iterator<char>(imageIn)), istreambuf_iterator<char>());
+    imageIn.close();
+    auto loads = [&](const string& bytes) {
+        ofstream(tablePath, ios::binary | ios::trunc).write(bytes.data(), bytes.size());
+        PerfectHashing probe;
+        return probe.loadMapped(tablePath);
+    };
+    // slotCount + 2^62 makes slotCount * 4 wrap back to the real length; every
+    // bucket then points far past the slots, under a recomputed checksum
+    string forged = image;
+    PerfectHashing::FileHeader forgedHeader;
+    memcpy(&forgedHeader, forged.data(), sizeof(forgedHeader));
+    size_t headerBytes = (size_t)forgedHeader.primarySize * forgedHeader.bucketHeaderSize;
+    size_t slotBytes = forged.size() - sizeof(forgedHeader) - headerBytes;
+    forgedHeader.slotCount += 1ULL << 62;
+    for (uint32_t i = 0; i < forgedHeader.primarySize; i++) {
+        uint32_t farOffset = 0xF0000000u;  // BucketHeader::offset follows the 16 bytes of a and b
+        memcpy(&forged[sizeof(forgedHeader) + i * forgedHeader.bucketHeaderSize + 16], &farOffset, sizeof(farOffset));
+    }
+    const char* forgedPayload = forged.data() + sizeof(forgedHeader);
+    forgedHeader.checksum = PerfectHashing::checksum(forgedPayload + headerBytes, slotBytes,
+                                                     PerfectHashing::checksum(forgedPayload, headerBytes));
+    memcpy(&forged[0], &forgedHeader, sizeof(forgedHeader));
+    cout << "Truncated file " << (loads(image.substr(0, image.size() - 4)) ? "loaded" : "rejected")
+         << ", header only " << (loads(image.substr(0, sizeof(PerfectHashing::FileHeader))) ? "loaded" : "rejected")
+         << ", forged slot count " << (loads(forged) ? "loaded" : "rejected") << "\n";
+    remove(tablePath.c_str());
+    
+    // Test Case 10: Generic keys and values
+    cout << "\nTest 10: String and 64-bit keys with payloads\n";
+    PerfectHashMap<string, int> monthDays({{"jan", 31}, {"feb", 28}, {"mar", 31}, {"apr", 30},
+                                           {"may", 31}, {"jun", 30}, {"jul", 31}, {"aug", 31},
+                                           {"sep", 30}, {"oct", 31}, {"nov", 30}, {"dec", 31}});
+    for (string month : {"feb", "apr", "dec", "xyz"}) {
+        const int* days = monthDays.find(month);
+        if (days) cout << month << " -> " << *days << " days\n";
+        else cout << month << " -> not found\n";
+    }
+    
+    PerfectHashMap<int64_t, string> codes({{-1, "minus one"}, {INT64_MIN, "min"}, {1LL << 40, "2^40"}});
+    cout << "-1 -> " << *codes.find(-1) << ", 2^40 -> " << *codes.find(1LL << 40)
+         << ", 0 " << (codes.contains(0) ? "found" : "not found") << "\n";
+    
+    vector<pair<string, int>> words;
+    for (int i = 0; i < 100000; i++) words.push_back({"word" + to_string(i * 7 + 3), i});
+    PerfectHashMap<string, int> wordIndex(words);
+    int wordsFound = 0;
+    for (auto& [word, index] : words) {
+        const int* value = wordIndex.find(word);
+        wordsFound += value && *value == index;
+    }
+    cout << "Found " << wordsFound << "/" << words.size() << " words with their payload\n";
+    wordIndex.statistics();
+    
+    // Test Case 11: Compact pilot layout against the frozen k² layout
+    cout << "\nTest 11: Compact (pilot) layout vs FKS layout, " << bulkKeys.size() << " keys\n";
+    {
+        auto start = chrono::steady_clock::now();
+        PerfectHashing fksTable(bulkKeys);
+        fksTable.freeze(true);
+        double fksBuildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        
+        CompactPerfectHashing compactTable;
+        PerfectHashing::BuildReport compactReport = compactTable.build(bulkKeys);
+        
+        // Half present, half absent keys in random order
+        vector<int> probes;
+        for (int key : bulkKeys) probes.push_back(key), probes.push_back(key + 1);
+        shuffle(probes.begin(), probes.end(), mt19937(7));
+        vector<uint8_t> results(probes.size());
+        
+        auto timeLookups = [&](auto&& lookup) {
+            auto begin = chrono::steady_clock::now();
+            size_t hits = 0;
+            for (int round = 0; round < 10; round++) hits += lookup();
+            double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+            return make_pair(ns / (10.0 * probes.size()), hits / 10);
+        };
+        auto fksSingle = timeLookups([&] { size_t h = 0; for (int key : probes) h += fksTable.search(key); return h; });
+        auto fksBatch = timeLookups([&] {
+            fksTable.searchBatch(probes.data(), probes.size(), results.data());
+            return (size_t)count(results.begin(), results.end(), 1);
+        });
+        auto compactSingle = timeLookups([&] { size_t h = 0; for (int key : probes) h += compactTable.search(key); return h; });
+        auto compactBatch = timeLookups([&] {
+            compactTable.searchBatch(probes.data(), probes.size(), results.data());
+            return (size_t)count(results.begin(), results.end(), 1);
+        });
+        
+        size_t fksBytes = fksTable.memoryBytes();
+        
+        cout << fixed << setprecision(2);
+        cout << "Layout   Build ms  Bytes/key  ns/lookup  ns/lookup (batch)  Hits\n";
+        cout << "FKS k²   " << setw(8) << fksBuildMs << "  " << setw(9) << (double)fksBytes / bulkKeys.size()
+             << "  " << setw(9) << fksSingle.first << "  " << setw(17) << fksBatch.first << "  " << fksSingle.second << "\n";
+        cout << "Compact  " << setw(8) << compactReport.milliseconds << "  " << setw(9)
+             << (double)compactTable.memoryBytes() / bulkKeys.size() << "  " << setw(9) << compactSingle.first
+             << "  " << setw(17) << compactBatch.first << "  " << compactSingle.second << "\n";
+        compactTable.statistics();
+    }
+    
+    // Test Case 12: Keys 2^31 - 1 apart share (a*x + b) mod p for every a, b
+    cout << "\nTest 12: Keys no modulo-prime function can separate\n";
+    PerfectHashing primeTable(4, PerfectHashing::MODULO_PRIME);
+    vector<int> twins = {5, (int)(5u + 2147483647u), 9, (int)(9u + 2147483647u)};
+    for (int key : twins) primeTable.insert(key);
+    for (int key : twins) cout << "Key " << key << (primeTable.search(key) ? " found" : " not found") << "\n";
+    primeTable.freeze();
+    cout << "Frozen: " << count_if(twins.begin(), twins.end(), [&](int key) { return primeTable.search(key); })
+         << "/" << twins.size() << " found\n";
+    primeTable.display();
+    
+    // Test Case 13: Erasing keys shrinks the tables with the live set
+    cout << "\nTest 13: Erasing 1900 of the 2010 keys left by Test 5\n";
+    int erased = 0;
+    for (int i = 0; i < 1900; i++) erased += hashTable.erase(1000 + i * 13);
+    int stillFound = 0;
+    for (int i = 1900; i < 2000; i++) stillFound += hashTable.search(1000 + i * 13);
+    cout << "Erased " << erased << ", " << (hashTable.search(1000) ? "1000 still found" : "1000 gone")
+         << ", " << stillFound << "/100 remaining keys found\n";
+    hashTable.statistics();
+    
+    // Test Case 14: Slowest single insert with rebuilds done inline vs spread out
+    cout << "\nTest 14: Insert latency tail over 1000000 inserts\n";
+    for (bool incremental : {false, true}) {
+        PerfectHashing growing(1, PerfectHashing::MULTIPLY_SHIFT, 11);
+        growing.setIncrementalRebuild(incremental);
+        vector<float> insertUs(1000000);
+        for (int i = 0; i < 1000000; i++) {
+            auto start = chrono::steady_clock::now();
+            growing.insert(i * 7 + 3);
+            insertUs[i] = chrono::duration<float, micro>(chrono::steady_clock::now() - start).count();
+        }
+        int pendingBefore = growing.pendingKeys();
+        growing.finishRebuilds();
+        int missing = 0;
+        for (int i = 0; i < 1000000; i += 101) missing += !growing.search(i * 7 + 3);
+        
+        // Inline, the slowest inserts are the ones that ran a global rehash
+        int overMs = count_if(insertUs.begin(), insertUs.end(), [](float us) { return us > 1000; });
+        cout << (incremental ? "Incremental: " : "Inline:      ") << fixed << setprecision(2)
+             << "slowest " << *max_element(insertUs.begin(), insertUs.end()) / 1000 << " ms, "
+             << overMs << " over 1 ms, " << pendingBefore << " keys pending at the end, "
+             << missing << " sampled keys missing\n";
+    }
+    
+    // Test Case 15: Random lookups over a large frozen table, heap vs huge pages
+    cout << "\nTest 15: Random lookups over 2000000 keys, heap vs huge page layout\n";
+    vector<uint32_t> largeIds = bench::makeKeys(2000000, bench::UNIFORM);
+    vector<int> largeKeys(largeIds.begin(), largeIds.end());
+    vector<uint32_t> probeIds = bench::makeProbes(largeIds, bench::UNIFORM, 2000000, 1.0);
+    for (bool huge : {false, true}) {
+        PerfectHashing large(largeKeys, PerfectHashing::MULTIPLY_SHIFT, 13);
+        large.setHugePageLayout(huge);
+        large.freeze(true);
+        int found = 0;
+        bench::Result lookups = bench::timeOps(probeIds.size(), [&](size_t j) { found += large.search(probeIds[j]); });
+        cout << (huge ? "Huge pages: " : "Heap:       ") << fixed << setprecision(1)
+             << lookups.nsPerOp << " ns/lookup, p99 " << lookups.p99Ns << " ns, "
+             << found << "/" << probeIds.size() << " found\n";
+    }
+    
+    // Test Case 16: Readers on every node served from their node's copy
+    cout << "\nTest 16: NUMA-replicated frozen table, 4 reader threads\n";
+    vector<int> replicatedKeys(largeKeys.begin(), largeKeys.begin() + 200000);
+    PerfectHashing replicated(replicatedKeys, PerfectHashing::MULTIPLY_SHIFT, 17);
+    replicated.setNumaReplication(true);
+    replicated.freeze(true);
+    vector<int> threadFound(4, 0);
+    vector<thread> nodeReaders;
+    for (int r = 0; r < 4; r++) {
+        nodeReaders.emplace_back([&, r] {
+            for (size_t j = r; j < replicatedKeys.size(); j += 4) threadFound[r] += replicated.search(replicatedKeys[j]);
+        });
+    }
+    for (thread& reader : nodeReaders) reader.join();
+    cout << "Found " << accumulate(threadFound.begin(), threadFound.end(), 0) << "/" << replicatedKeys.size()
+         << " keys (replicas are skipped on single-node machines)\n";
+    replicated.statistics();
+    
+    // Test Case 17: A table built by the compiler
+    cout << "\nTest 17: Opcode table built at compile time\n";
+    static constexpr int OPCODE_KEYS[] = {0x00, 0x01, 0x03, 0x0b, 0x1f, 0x20, 0x42, 0x7f, 0x80, 0xc3, 0xe8, 0xff};
+    static constexpr auto OPCODES = makeStaticPerfectHashing(OPCODE_KEYS);
+    static_assert(OPCODES.valid(), "opcode keys must be distinct");
+    static_assert(OPCODES.contains(0x42) && !OPCODES.contains(0x43), "checked by the compiler");
+    cout << OPCODES.size() << " keys in " << OPCODES.slotsUsed() << " slots (bound " << 4 * OPCODES.size() << ")\n";
+    for (int opcode : {0x0b, 0xc3, 0x10, 0xff, 0x100}) {
+        cout << "Opcode 0x" << hex << opcode << dec << (OPCODES.contains(opcode) ? " found" : " not found")
+             << ", slot " << OPCODES.slotOf(opcode) << "\n";
+    }
+    
+    // Test Case 18: -1 marks empty slots, so it must not match them
+    cout << "\nTest 18: Key -1 alongside erased slots\n";
+    PerfectHashing sentinel(4, PerfectHashing::MULTIPLY_SHIFT, 18);
+    for (int key = 0; key < 64; key++) sentinel.insert(key);
+    for (int key = 0; key < 64; key += 2) sentinel.erase(key);
+    int minusOneProbe = -1;
+    uint8_t minusOneBatch;
+    sentinel.freeze();
+    sentinel.searchBatch(&minusOneProbe, 1, &minusOneBatch);
+    cout << "Before insert: search(-1) = " << sentinel.search(-1) << ", searchBatch = " << (int)minusOneBatch << "\n";
+    sentinel.insert(-1);
+    sentinel.freeze();
+    sentinel.searchBatch(&minusOneProbe, 1, &minusOneBatch);
+    cout << "After insert:  search(-1) = " << sentinel.search(-1) << ", searchBatch = " << (int)minusOneBatch << "\n";
+    bool erasedMinusOne = sentinel.erase(-1);
+    cout << "erase(-1) = " << erasedMinusOne << ", then search(-1) = " << sentinel.search(-1) << "\n";
+    
     cout << "\n============================================\n";
     cout << "  Algorithm Characteristics:\n";
     cout << "============================================\n";
@@ -267,6 +3231,16 @@ int main() {
     cout << "• Uses universal hashing at both levels\n";
     cout << "• Secondary table size = k² for k keys in bucket\n";
     cout << "• Guarantees collision-free hashing\n";
+    cout << "• Builds never fail: tables grow past k², then stash what still collides\n";
+    cout << "• Erase clears one slot; tables and the primary level shrink lazily\n";
+    cout << "• Incremental mode spreads rebuilds and rehashes over later inserts\n";
+    cout << "• Wait-free concurrent lookups alongside one writer\n";
+    cout << "• Frozen tables can be saved and memory-mapped back\n";
+    cout << "• Frozen layout can live on 2 MB pages, one-key buckets inline in their header\n";
+    cout << "• Optional per-NUMA-node replicas serve each lookup from local memory\n";
+    cout << "• PerfectHashMap stores any key type with a payload\n";
+    cout << "• CompactPerfectHashing trades the k² slots for ~5 bits/key of pilots\n";
+    cout << "• StaticPerfectHashing builds the same two levels at compile time\n";
     
     return 0;
 }
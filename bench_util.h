@@ -0,0 +1,303 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+    Shared workload and measurement helpers for the --bench modes of the
+    three programs. Build with -DBENCH_COUNT_ALLOCS to replace global
+    operator new/delete with counting versions: every result then reports
+    allocations per operation, and live heap bytes give bytes/key for
+    structures whose memory is spread across many blocks (e.g. std::string
+    keys). Replacement operators can't be inline, so the macro must reach
+    exactly one translation unit per program; without it the default
+    allocator is used and those columns print as "-". CountingAllocator
+    feeds the same counters from one container's allocations in any build.
+    Blocks from malloc/realloc/mmap directly (DynamicArray's in-place path)
+    are not seen by the counters.
+
+    Latency is timed in batches of BATCH operations, since one clock read
+    costs about as much as one lookup; p99 is the 99th percentile of the
+    per-operation average within a batch.
+*/
+namespace bench {
+
+#ifdef BENCH_COUNT_ALLOCS
+static const bool COUNTS_ALLOCS = true;
+#else
+static const bool COUNTS_ALLOCS = false;
+#endif
+
+struct AllocStats {
+    static inline std::atomic<size_t> calls{0};
+    static inline std::atomic<size_t> liveBytes{0};
+    static inline std::atomic<size_t> peakBytes{0};
+    
+    // Start a new high-water mark from the current live bytes
+    static void resetPeak() {
+        peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+};
+
+// Header in front of every counted block so delete knows its size
+static const size_t ALLOC_HEADER = 16;
+
+inline void* countedAlloc(size_t size) {
+    void* block = std::malloc(size + ALLOC_HEADER);
+    if (!block) throw std::bad_alloc();
+    *static_cast<size_t*>(block) = size;
+    AllocStats::calls.fetch_add(1, std::memory_order_relaxed);
+    size_t live = AllocStats::liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = AllocStats::peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !AllocStats::peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    return static_cast<char*>(block) + ALLOC_HEADER;
+}
+
+// GCC can't see that p came from countedAlloc's malloc once operator delete
+// is inlined, so it would flag the free as mismatching operator new
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+inline void countedFree(void* p) {
+    if (!p) return;
+    void* block = static_cast<char*>(p) - ALLOC_HEADER;
+    AllocStats::liveBytes.fetch_sub(*static_cast<size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Standard allocator over countedAlloc/countedFree, so a container's blocks
+// are counted even when the global operators are not replaced
+template <class T>
+struct CountingAllocator {
+    using value_type = T;
+    
+    CountingAllocator() = default;
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+    
+    T* allocate(size_t n) {
+        return static_cast<T*>(countedAlloc(n * sizeof(T)));
+    }
+    
+    void deallocate(T* p, size_t) {
+        countedFree(p);
+    }
+    
+    template <class U>
+    bool operator==(const CountingAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const CountingAllocator<U>&) const { return false; }
+};
+
+enum Distribution { UNIFORM, ZIPF, ADVERSARIAL };
+
+inline const char* distributionName(Distribution d) {
+    return d == UNIFORM ? "uniform" : d == ZIPF ? "zipf" : "adversarial";
+}
+
+// Bijective 32-bit mixer (murmur3 finalizer): distinct inputs, distinct keys
+inline uint32_t mix32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6bU;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35U;
+    return x ^ (x >> 16);
+}
+
+// Lowest shift that keeps n keys i << shift distinct in 32 bits
+inline int adversarialShift(size_t n) {
+    int bits = 1;
+    while (bits < 32 && (size_t(1) << bits) < n) bits++;
+    return 32 - bits;
+}
+
+/*
+    n distinct 32-bit keys. UNIFORM and ZIPF share a random-looking key set
+    (the distributions differ in which keys lookups pick); ADVERSARIAL keys
+    are i << shift, identical in every low bit, the classic bad case for
+    hashes that reduce by masking or by a modulus sharing factors with 2.
+*/
+inline std::vector<uint32_t> makeKeys(size_t n, Distribution d) {
+    std::vector<uint32_t> keys(n);
+    int shift = adversarialShift(n);
+    for (size_t i = 0; i < n; i++) keys[i] = d == ADVERSARIAL ? uint32_t(i) << shift : mix32(i);
+    return keys;
+}
+
+// A key guaranteed absent from makeKeys(n, d), the j-th such key
+inline uint32_t missingKey(size_t n, Distribution d, size_t j) {
+    if (d == ADVERSARIAL) return (uint32_t(j % n) << adversarialShift(n)) | 1;
+    return mix32(n + j % ((size_t(1) << 32) - n));
+}
+
+// String form of a key: short (inline-sized) for UNIFORM and ZIPF, a long
+// shared prefix for ADVERSARIAL so every compare walks the whole prefix
+inline std::string keyString(uint32_t key, Distribution d) {
+    std::string digits = std::to_string(key);
+    if (d != ADVERSARIAL) return "k" + digits;
+    return "tenant/00000000/session/00000000/object/" + digits;
+}
+
+struct SplitMix {
+    uint64_t state;
+
+    explicit SplitMix(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// Zipf-distributed ranks in [0, n) with skew theta (Gray et al., "Quickly
+// Generating Billion-Record Synthetic Databases"); O(n) setup, O(1) draws
+class Zipf {
+private:
+    size_t n;
+    double theta, alpha, zetan, eta;
+
+public:
+    Zipf(size_t count, double skew = 0.99) : n(count), theta(skew), zetan(0) {
+        for (size_t i = 1; i <= n; i++) zetan += 1.0 / std::pow((double)i, theta);
+        double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    size_t next(SplitMix& rng) const {
+        double u = rng.uniform();
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return std::min<size_t>(1, n - 1);
+        return std::min<size_t>(n - 1, (size_t)(n * std::pow(eta * u - eta + 1.0, alpha)));
+    }
+};
+
+/*
+    count lookup keys over makeKeys(n, d): a fraction hitRatio are present
+    keys (uniform index, or Zipf rank for ZIPF), the rest are absent keys.
+*/
+inline std::vector<uint32_t> makeProbes(const std::vector<uint32_t>& keys, Distribution d,
+                                        size_t count, double hitRatio, uint64_t seed = 1) {
+    SplitMix rng(seed);
+    std::vector<uint32_t> probes(count);
+    if (keys.empty()) return probes;
+    Zipf* zipf = d == ZIPF ? new Zipf(keys.size()) : nullptr;
+    for (size_t j = 0; j < count; j++) {
+        if (rng.uniform() < hitRatio) {
+            probes[j] = keys[zipf ? zipf->next(rng) : rng.next() % keys.size()];
+        } else {
+            probes[j] = missingKey(keys.size(), d, rng.next());
+        }
+    }
+    delete zipf;
+    return probes;
+}
+
+struct Result {
+    double nsPerOp;
+    double p99Ns;
+    double allocsPerOp;
+};
+
+static const size_t BATCH = 16;
+
+// Run op(0) .. op(count - 1) and time them in batches
+template <class Op>
+Result timeOps(size_t count, Op op) {
+    std::vector<float> batchNs;
+    batchNs.reserve(count / BATCH + 1);
+    size_t allocsBefore = AllocStats::calls.load(std::memory_order_relaxed);
+
+    auto begin = std::chrono::steady_clock::now();
+    auto last = begin;
+    for (size_t base = 0; base < count; base += BATCH) {
+        size_t end = std::min(count, base + BATCH);
+        for (size_t i = base; i < end; i++) op(i);
+        auto now = std::chrono::steady_clock::now();
+        batchNs.push_back(std::chrono::duration<float, std::nano>(now - last).count() / (end - base));
+        last = now;
+    }
+    double totalNs = std::chrono::duration<double, std::nano>(last - begin).count();
+
+    Result result;
+    result.nsPerOp = count ? totalNs / count : 0;
+    result.allocsPerOp = count ? double(AllocStats::calls.load(std::memory_order_relaxed) - allocsBefore) / count : 0;
+    result.p99Ns = 0;
+    if (!batchNs.empty()) {
+        size_t rank = std::min(batchNs.size() - 1, batchNs.size() * 99 / 100);
+        std::nth_element(batchNs.begin(), batchNs.begin() + rank, batchNs.end());
+        result.p99Ns = batchNs[rank];
+    }
+    return result;
+}
+
+inline void printHeader() {
+    std::cout << std::left << std::setw(22) << "Operation" << std::setw(13) << "Keys"
+              << std::setw(10) << "Size" << std::right << std::setw(6) << "Hit%"
+              << std::setw(10) << "ns/op" << std::setw(10) << "p99 ns"
+              << std::setw(11) << "bytes/key" << std::setw(11) << "allocs/op" << "\n";
+}
+
+// hitPercent < 0 and bytesPerKey < 0 print as "-", as does allocs/op when
+// allocations aren't counted
+inline void printRow(const std::string& operation, Distribution d, size_t n, int hitPercent,
+                     const Result& result, double bytesPerKey) {
+    std::cout << std::left << std::setw(22) << operation << std::setw(13) << distributionName(d)
+              << std::setw(10) << n << std::right << std::fixed << std::setprecision(1);
+    if (hitPercent < 0) std::cout << std::setw(6) << "-";
+    else std::cout << std::setw(6) << hitPercent;
+    std::cout << std::setw(10) << result.nsPerOp << std::setw(10) << result.p99Ns;
+    if (bytesPerKey < 0) std::cout << std::setw(11) << "-";
+    else std::cout << std::setw(11) << bytesPerKey;
+    if (!COUNTS_ALLOCS) std::cout << std::setw(11) << "-" << "\n";
+    else std::cout << std::setw(11) << std::setprecision(2) << result.allocsPerOp << "\n";
+}
+
+// Sizes 1K, 10K, ... up to maxSize
+inline std::vector<size_t> benchSizes(size_t maxSize) {
+    std::vector<size_t> sizes;
+    for (size_t n = 1000; n <= maxSize; n *= 10) sizes.push_back(n);
+    return sizes;
+}
+
+}  // namespace bench
+
+#ifdef BENCH_COUNT_ALLOCS
+void* operator new(size_t size) { return bench::countedAlloc(size); }
+void* operator new[](size_t size) { return bench::countedAlloc(size); }
+void operator delete(void* p) noexcept { bench::countedFree(p); }
+void operator delete[](void* p) noexcept { bench::countedFree(p); }
+void operator delete(void* p, size_t) noexcept { bench::countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { bench::countedFree(p); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try { return bench::countedAlloc(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try { return bench::countedAlloc(size); } catch (...) { return nullptr; }
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept { bench::countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { bench::countedFree(p); }
+#endif
+
+#endif
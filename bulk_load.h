@@ -0,0 +1,252 @@
+#ifndef BULK_LOAD_H
+#define BULK_LOAD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+    Streaming ingest for the --load modes of the dictionary and FKS
+    programs. Input arrives in chunks of about CHUNK bytes that end on a
+    line boundary: a regular file is mapped and walked in place (with
+    MADV_SEQUENTIAL so the kernel reads ahead), anything else (stdin, pipes)
+    is read with fread into one reusable buffer. Records are parsed by hand
+    rather than with iostreams, so a load is bound by read bandwidth.
+
+    One record per line: "key value" for key/value files, one or more
+    whitespace-separated ints for key files. Blank lines are ignored;
+    malformed lines are counted and skipped.
+*/
+namespace bulk {
+
+static const size_t CHUNK = size_t(1) << 22;
+
+struct LoadStats {
+    bool opened = false;
+    size_t records = 0;  // Records handed to the callback
+    size_t skipped = 0;  // Malformed lines
+    size_t bytes = 0;    // Input bytes consumed
+};
+
+class ChunkReader {
+private:
+    std::FILE* file = nullptr;
+    bool ownsFile = false;
+    const char* map = nullptr;
+    size_t mapLength = 0, mapPos = 0;
+    std::vector<char> buffer;
+    size_t consumed = 0;  // Front of buffer handed out by the last chunk
+    size_t carry = 0;     // Bytes of an unfinished line after `consumed`
+    bool eof = false;
+
+public:
+    // path "-" reads standard input
+    explicit ChunkReader(const char* path) {
+        if (std::strcmp(path, "-") == 0) {
+            file = stdin;
+            return;
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            mapLength = info.st_size;
+            void* base = mapLength ? mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            if (base != MAP_FAILED) {
+                map = static_cast<const char*>(base);
+#ifdef MADV_SEQUENTIAL
+                madvise(base, mapLength, MADV_SEQUENTIAL);
+#endif
+            }
+        }
+        close(fd);
+        if (map) return;
+        mapLength = 0;
+#endif
+        file = std::fopen(path, "rb");
+        ownsFile = file != nullptr;
+    }
+
+    ChunkReader(const ChunkReader&) = delete;
+    ChunkReader& operator=(const ChunkReader&) = delete;
+
+    ~ChunkReader() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (map) munmap(const_cast<char*>(map), mapLength);
+#endif
+        if (ownsFile) std::fclose(file);
+    }
+
+    bool ok() const { return map || file; }
+
+    // Next piece of input holding whole lines (the input's last line may
+    // lack its newline); false at end of input. The view is valid until
+    // the next call.
+    bool next(std::string_view& chunk) {
+        if (map) {
+            if (mapPos >= mapLength) return false;
+            size_t end = mapLength;
+            if (mapLength - mapPos > CHUNK) {
+                const void* newline = std::memchr(map + mapPos + CHUNK, '\n', mapLength - mapPos - CHUNK);
+                if (newline) end = static_cast<const char*>(newline) - map + 1;
+            }
+            chunk = std::string_view(map + mapPos, end - mapPos);
+            mapPos = end;
+            return true;
+        }
+        if (!file) return false;
+
+        // Move the unfinished line left by the last chunk to the front
+        if (carry) std::memmove(buffer.data(), buffer.data() + consumed, carry);
+        consumed = 0;
+        while (true) {
+            if (buffer.size() < carry + CHUNK) buffer.resize(carry + CHUNK);
+            size_t got = eof ? 0 : std::fread(buffer.data() + carry, 1, CHUNK, file);
+            eof = eof || got < CHUNK;
+            size_t filled = carry + got;
+            size_t end = filled;
+            if (!eof) {
+                while (end > 0 && buffer[end - 1] != '\n') end--;
+                if (end == 0) {
+                    // One line longer than everything read so far: read on
+                    carry = filled;
+                    continue;
+                }
+            }
+            if (filled == 0) return false;
+            chunk = std::string_view(buffer.data(), end);
+            consumed = end;
+            carry = filled - end;
+            return true;
+        }
+    }
+};
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+// Parse a decimal int at p, advancing p past it; false (p unspecified) if
+// there are no digits or the value overflows int
+inline bool parseInt(const char*& p, const char* end, int& out) {
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) p++;
+    const char* digits = p;
+    int64_t value = 0;
+    while (p < end && unsigned(*p - '0') < 10) {
+        value = value * 10 + (*p - '0');
+        if (value > int64_t(INT32_MAX) + 1) return false;
+        p++;
+    }
+    if (p == digits) return false;
+    if (negative) value = -value;
+    if (value > INT32_MAX) return false;
+    out = int(value);
+    return true;
+}
+
+// Parse a token of non-blank characters at p, advancing p past it
+inline bool parseToken(const char*& p, const char* end, std::string_view& out) {
+    const char* start = p;
+    while (p < end && !isBlank(*p)) p++;
+    out = std::string_view(start, p - start);
+    return p > start;
+}
+
+// Call fn(line) for every line of chunk, without its newline
+template <class Fn>
+void forEachLine(std::string_view chunk, Fn fn) {
+    const char* p = chunk.data();
+    const char* end = p + chunk.size();
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = newline ? newline : end;
+        fn(p, lineEnd);
+        p = newline ? newline + 1 : end;
+    }
+}
+
+struct KeyValue {
+    std::string_view key;
+    int value;
+};
+
+// Stream "key value" lines from path, calling fn(batch) with the records
+// of each chunk (a std::vector<KeyValue>). Keys view the input, so they
+// are valid only during the call.
+template <class Fn>
+LoadStats readKeyValues(const char* path, Fn fn) {
+    LoadStats stats;
+    ChunkReader reader(path);
+    stats.opened = reader.ok();
+    std::vector<KeyValue> batch;
+    std::string_view chunk;
+    while (reader.next(chunk)) {
+        stats.bytes += chunk.size();
+        batch.clear();
+        forEachLine(chunk, [&](const char* p, const char* end) {
+            p = skipBlanks(p, end);
+            if (p == end) return;
+            KeyValue record;
+            bool parsed = parseToken(p, end, record.key);
+            p = skipBlanks(p, end);
+            parsed = parsed && parseInt(p, end, record.value) && skipBlanks(p, end) == end;
+            if (parsed) batch.push_back(record);
+            else stats.skipped++;
+        });
+        stats.records += batch.size();
+        if (!batch.empty()) fn(batch);
+    }
+    return stats;
+}
+
+// Stream whitespace-separated ints from path, calling fn(keys, n) with the
+// keys of each chunk
+template <class Fn>
+LoadStats readInts(const char* path, Fn fn) {
+    LoadStats stats;
+    ChunkReader reader(path);
+    stats.opened = reader.ok();
+    std::vector<int> batch;
+    std::string_view chunk;
+    while (reader.next(chunk)) {
+        stats.bytes += chunk.size();
+        batch.clear();
+        forEachLine(chunk, [&](const char* p, const char* end) {
+            size_t before = batch.size();
+            for (p = skipBlanks(p, end); p < end; p = skipBlanks(p, end)) {
+                int key;
+                if (!parseInt(p, end, key) || (p < end && !isBlank(*p))) {
+                    batch.resize(before);
+                    stats.skipped++;
+                    return;
+                }
+                batch.push_back(key);
+            }
+        });
+        stats.records += batch.size();
+        if (!batch.empty()) fn(batch.data(), batch.size());
+    }
+    return stats;
+}
+
+}  // namespace bulk
+
+#endif
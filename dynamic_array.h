@@ -0,0 +1,292 @@
+#ifndef DYNAMIC_ARRAY_H
+#define DYNAMIC_ARRAY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+    Resize policy for DynamicArray: capacity grows by GrowNum/GrowDen when
+    full, and once size drops to capacity/ShrinkDivisor it shrinks by the
+    same factor, never below MinCapacity. ShrinkDivisor must exceed the
+    growth factor so a shrink leaves slack and push/pop at a boundary
+    can't thrash.
+*/
+template <size_t GrowNum, size_t GrowDen, size_t ShrinkDivisor, size_t MinCapacity>
+struct GrowthPolicy {
+    static_assert(GrowNum > GrowDen, "growth factor must exceed 1");
+    static_assert(ShrinkDivisor * GrowDen > GrowNum, "shrink threshold must leave hysteresis");
+
+    static size_t grow(size_t cap, size_t needed) {
+        return std::max({needed, cap * GrowNum / GrowDen, MinCapacity});
+    }
+
+    static bool shouldShrink(size_t size, size_t cap) {
+        return size > 0 && cap > MinCapacity && size <= cap / ShrinkDivisor;
+    }
+
+    static size_t shrink(size_t cap) {
+        return std::max(cap * GrowDen / GrowNum, MinCapacity);
+    }
+};
+
+// Double when full, halve at a quarter: the classic policy and the default
+using DoublingGrowth = GrowthPolicy<2, 1, 4, 1>;
+// Grow by 1.5x, shrink at a third: at most a third of the block is unused
+// after growth, and freed blocks can be reused by later, larger requests
+using OneAndHalfGrowth = GrowthPolicy<3, 2, 3, 4>;
+
+/*
+    Growable array with amortized O(1) push and pop.
+
+    Capacity follows Policy (DoublingGrowth by default). Storage comes from
+    Allocator and only the first size() elements are constructed; growth
+    relocates them with move construction (std::move_if_noexcept, so a
+    throwing move falls back to copying). Each instance owns its state, so
+    separate arrays can be used from separate threads freely.
+
+    Trivially copyable elements with the default allocator skip element-wise
+    relocation: blocks come from malloc and resize with realloc, and on Linux
+    blocks of MAP_THRESHOLD bytes or more are mapped directly and resized with
+    mremap, so the kernel moves page tables instead of copying the data and
+    RSS never holds two copies of a huge array.
+*/
+template <class T, class Allocator = std::allocator<T>, class Policy = DoublingGrowth>
+class DynamicArray {
+private:
+    using Traits = std::allocator_traits<Allocator>;
+
+    static constexpr bool RAW_STORAGE =
+        std::is_trivially_copyable<T>::value && std::is_same<Allocator, std::allocator<T>>::value;
+    static const size_t MAP_THRESHOLD = size_t(1) << 21;
+
+    Allocator alloc;
+    T* arr;
+    size_t sz, cap;
+
+#ifdef __linux__
+    static size_t pageRound(size_t bytes) {
+        static const size_t page = sysconf(_SC_PAGESIZE);
+        return (bytes + page - 1) / page * page;
+    }
+#endif
+
+    static void releaseBlock(void* block, size_t bytes) {
+        if (!block) return;
+#ifdef __linux__
+        if (bytes >= MAP_THRESHOLD) {
+            munmap(block, pageRound(bytes));
+            return;
+        }
+#endif
+        (void)bytes;
+        free(block);
+    }
+
+    // Resize a RAW_STORAGE block, keeping min(oldBytes, newBytes) bytes
+    static void* reallocBlock(void* block, size_t oldBytes, size_t newBytes) {
+        if (newBytes == 0) {
+            releaseBlock(block, oldBytes);
+            return nullptr;
+        }
+#ifdef __linux__
+        bool oldMapped = oldBytes >= MAP_THRESHOLD, newMapped = newBytes >= MAP_THRESHOLD;
+        if (oldMapped && newMapped) {
+            void* moved = mremap(block, pageRound(oldBytes), pageRound(newBytes), MREMAP_MAYMOVE);
+            if (moved == MAP_FAILED) throw std::bad_alloc();
+            return moved;
+        }
+        if (oldMapped || newMapped) {
+            // Crossing the threshold: the one growth step that copies
+            void* fresh = newMapped ? mmap(nullptr, pageRound(newBytes), PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                                    : malloc(newBytes);
+            if (fresh == MAP_FAILED || !fresh) throw std::bad_alloc();
+            if (block) memcpy(fresh, block, std::min(oldBytes, newBytes));
+            releaseBlock(block, oldBytes);
+            return fresh;
+        }
+#endif
+        void* resized = realloc(block, newBytes);
+        if (!resized) throw std::bad_alloc();
+        return resized;
+    }
+
+    // Move the live elements into storage for newCap elements
+    void resize(size_t newCap) {
+        if constexpr (RAW_STORAGE) {
+            arr = static_cast<T*>(reallocBlock(arr, cap * sizeof(T), newCap * sizeof(T)));
+            cap = newCap;
+            return;
+        }
+        T* newArr = newCap ? Traits::allocate(alloc, newCap) : nullptr;
+        size_t moved = 0;
+        try {
+            for (; moved < sz; moved++) Traits::construct(alloc, newArr + moved, std::move_if_noexcept(arr[moved]));
+        } catch (...) {
+            destroyRange(newArr, moved);
+            if (newArr) Traits::deallocate(alloc, newArr, newCap);
+            throw;
+        }
+        destroyRange(arr, sz);
+        if (arr) Traits::deallocate(alloc, arr, cap);
+        arr = newArr;
+        cap = newCap;
+    }
+
+    void destroyRange(T* first, size_t count) {
+        for (size_t i = 0; i < count; i++) Traits::destroy(alloc, first + i);
+    }
+
+    void grow(size_t needed) {
+        if (needed > cap) resize(Policy::grow(cap, needed));
+    }
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    explicit DynamicArray(const Allocator& allocator = Allocator())
+        : alloc(allocator), arr(nullptr), sz(0), cap(0) {}
+
+    DynamicArray(std::initializer_list<T> values, const Allocator& allocator = Allocator())
+        : DynamicArray(allocator) {
+        append(values.begin(), values.end());
+    }
+
+    DynamicArray(const DynamicArray& other)
+        : DynamicArray(Traits::select_on_container_copy_construction(other.alloc)) {
+        append(other.begin(), other.end());
+    }
+
+    DynamicArray(DynamicArray&& other) noexcept
+        : alloc(std::move(other.alloc)), arr(other.arr), sz(other.sz), cap(other.cap) {
+        other.arr = nullptr;
+        other.sz = other.cap = 0;
+    }
+
+    DynamicArray& operator=(DynamicArray other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~DynamicArray() {
+        clear();
+        if constexpr (RAW_STORAGE) releaseBlock(arr, cap * sizeof(T));
+        else if (arr) Traits::deallocate(alloc, arr, cap);
+    }
+
+    void swap(DynamicArray& other) noexcept {
+        using std::swap;
+        swap(alloc, other.alloc);
+        swap(arr, other.arr);
+        swap(sz, other.sz);
+        swap(cap, other.cap);
+    }
+
+    // Make room for at least n elements without further reallocation
+    void reserve(size_t n) {
+        if (n > cap) resize(n);
+    }
+
+    template <class... Args>
+    T& emplace_back(Args&&... args) {
+        if (sz == cap) {
+            // Build first: args may refer to an element about to be moved
+            T value(std::forward<Args>(args)...);
+            grow(sz + 1);
+            Traits::construct(alloc, arr + sz, std::move(value));
+        } else {
+            Traits::construct(alloc, arr + sz, std::forward<Args>(args)...);
+        }
+        return arr[sz++];
+    }
+
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    // Append [first, last) with at most one reallocation for forward ranges
+    template <class InputIt>
+    void append(InputIt first, InputIt last) {
+        using Category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value) {
+            grow(sz + std::distance(first, last));
+            for (; first != last; ++first, ++sz) Traits::construct(alloc, arr + sz, *first);
+        } else {
+            for (; first != last; ++first) emplace_back(*first);
+        }
+    }
+
+    // Append n elements from values with one capacity decision; trivially
+    // copyable elements are copied with a single memcpy
+    void push_bulk(const T* values, size_t n) {
+        grow(sz + n);
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            if (n) memcpy(static_cast<void*>(arr + sz), values, n * sizeof(T));
+            sz += n;
+        } else {
+            for (size_t i = 0; i < n; i++, sz++) Traits::construct(alloc, arr + sz, values[i]);
+        }
+    }
+
+    // Remove the last min(n, size()) elements and shrink at most once;
+    // returns how many were removed
+    size_t pop_bulk(size_t n) {
+        n = std::min(n, sz);
+        destroyRange(arr + sz - n, n);
+        sz -= n;
+        size_t newCap = cap;
+        while (Policy::shouldShrink(sz, newCap)) newCap = Policy::shrink(newCap);
+        if (newCap != cap) resize(newCap);
+        return n;
+    }
+
+    // Remove the last element; returns false if the array is empty
+    bool pop_back() {
+        if (sz == 0) return false;
+        Traits::destroy(alloc, arr + --sz);
+        if (Policy::shouldShrink(sz, cap)) resize(Policy::shrink(cap));
+        return true;
+    }
+
+    // Release all spare capacity
+    void shrink_to_fit() {
+        if (cap > sz) resize(sz);
+    }
+
+    void clear() {
+        destroyRange(arr, sz);
+        sz = 0;
+    }
+
+    size_t size() const { return sz; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return sz == 0; }
+
+    T& operator[](size_t i) { return arr[i]; }
+    const T& operator[](size_t i) const { return arr[i]; }
+    T& back() { return arr[sz - 1]; }
+    const T& back() const { return arr[sz - 1]; }
+    T* data() { return arr; }
+    const T* data() const { return arr; }
+
+    iterator begin() { return arr; }
+    iterator end() { return arr + sz; }
+    const_iterator begin() const { return arr; }
+    const_iterator end() const { return arr + sz; }
+};
+
+#endif